@@ -1,5 +1,6 @@
 #include <iostream>
 #include <curl/curl.h>
+#include "metrics.h"
 
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
   ((std::string*)userp)->append((char*)contents, size * nmemb);
@@ -17,13 +18,18 @@ int main() {
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
 
-    res = curl_easy_perform(curl);
+    {
+      METRICS_TIMER("http_request");
+      res = curl_easy_perform(curl);
+    }
     if (res != CURLE_OK) {
       fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+      METRICS_COUNT("http_errors");
     }
 
     curl_easy_cleanup(curl);
     std::cout << "Response data: " << readBuffer << std::endl;
   }
+  METRICS_DUMP_FROM_ENV();
   return 0;
 }
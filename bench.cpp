@@ -0,0 +1,559 @@
+#define TASKY_NO_MAIN
+#include "tasky.cpp"
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <tuple>
+
+/**
+ * A namespace to provide a synthetic data generator and benchmarks for the core operations of tasky.
+ * Each run generates a database of a given size and times the operations behind the menus against it.
+ * The results are written as json with the median and 99th percentile time of each operation and the memory used.
+ */
+namespace Bench {
+  /**
+   * A struct representing the options of a benchmark run.
+   */
+  struct Options {
+    vector<long> sizes = { 10000 }; /**< The numbers of tasks to generate, one run each */
+    long users = 0; /**< The number of users to generate, or 0 for one user per 100 tasks */
+    double budget = 2.0; /**< The time in seconds to spend sampling each operation */
+    string out = ""; /**< The file to write the results to, or empty for standard output */
+    unsigned seed = 42; /**< The seed of the random number generator */
+    bool packed = false; /**< Whether to store the shards in the compact binary format */
+  };
+
+  /**
+   * A class to sample from a Zipf distribution over the ranks 0 to n - 1.
+   * Rank 0 is the most likely, and the probability of rank k is proportional to 1 / (k + 1)^s.
+   */
+  class Zipf {
+    private:
+    vector<double> cdf; /**< The cumulative probability of each rank */
+
+    public:
+    /**
+     * A constructor to create a Zipf distribution.
+     * @param n The number of ranks
+     * @param s The exponent of the distribution, larger is more skewed
+     */
+    Zipf(long n, double s) : cdf(n) {
+      double total = 0;
+      for (long k = 0; k < n; k++) {
+        total += 1.0 / std::pow(k + 1, s);
+        cdf[k] = total;
+      }
+      for (long k = 0; k < n; k++) cdf[k] /= total;
+    }
+    /**
+     * A function to sample a rank.
+     * @param rng The random number generator to use
+     * @returns The rank sampled
+     */
+    long sample(std::mt19937& rng) {
+      double u = std::uniform_real_distribution<double>(0, 1)(rng);
+      long k = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+      return k < cdf.size() ? k : cdf.size() - 1;
+    }
+  };
+
+  /**
+   * A struct representing the timings of one operation.
+   */
+  struct Result {
+    string name; /**< The name of the operation */
+    vector<double> samples; /**< The time of each call in nanoseconds */
+    string skipped; /**< The reason the operation was not timed, or empty if it was */
+  };
+
+  /**
+   * A class to generate realistic databases.
+   * Tasks are assigned to users with a Zipf distribution, so a few users own most of the tasks.
+   * Tags also follow a Zipf distribution, and dates are spread over two years around today.
+   */
+  class Generator {
+    private:
+    std::mt19937 rng; /**< The random number generator */
+    Zipf user_rank; /**< The distribution of tasks over users */
+    Zipf tag_rank; /**< The distribution of tags */
+    long users; /**< The number of users */
+    long count = 0; /**< The number of tasks generated so far */
+    vector<string> dates; /**< The dates from a year ago to a year and two months from now */
+    vector<string> words = { "review", "prepare", "meeting", "budget", "report", "client", "draft", "update", "plan", "call", "email", "design", "test", "deploy", "fix", "write", "read", "research", "order", "book" };
+
+    public:
+    static const int TAG_COUNT = 200; /**< The number of distinct tags */
+    static const int DATE_OFFSET = 365; /**< The position of today in the dates */
+
+    /**
+     * A constructor to create a generator.
+     * @param users The number of users to generate tasks for
+     * @param seed The seed of the random number generator
+     */
+    Generator(long users, unsigned seed) : rng(seed), user_rank(users, 1.1), tag_rank(TAG_COUNT, 1.0), users(users) {
+      // Format the dates once, since the C time functions are slow
+      string today = Helper::Date::today();
+      for (int i = -DATE_OFFSET; i < DATE_OFFSET + 60; i++)
+        dates.push_back(Helper::Date::add_days(today, i));
+    }
+
+    /**
+     * A function to get the name of a generated user.
+     * @param rank The rank of the user, where rank 0 has the most tasks
+     * @returns The username of the user
+     */
+    static string username(long rank) {
+      return "user" + to_string(rank);
+    }
+
+    /**
+     * A function to generate the users.
+     * @param db The database to add the users to
+     */
+    void generate_users(Database& db) {
+      db.users.reserve(db.users.size() + users);
+      for (long i = 0; i < users; i++)
+        db.add_user(User{username(i), "password" + to_string(i)});
+    }
+
+    /**
+     * A function to generate a task.
+     * @returns The task generated
+     */
+    Task generate_task() {
+      string description = "";
+      int length = std::uniform_int_distribution<int>(5, 40)(rng);
+      for (int i = 0; i < length; i++) {
+        if (i > 0) description += ' ';
+        description += words[std::uniform_int_distribution<int>(0, words.size() - 1)(rng)];
+      }
+
+      vector<string> tags;
+      int tag_count = std::uniform_int_distribution<int>(0, 3)(rng);
+      for (int i = 0; i < tag_count; i++)
+        tags.push_back("tag" + to_string(tag_rank.sample(rng)));
+
+      int start = std::uniform_int_distribution<int>(0, 2 * DATE_OFFSET - 1)(rng);
+      int due = start + std::uniform_int_distribution<int>(0, 59)(rng);
+
+      return Task{
+        username(user_rank.sample(rng)),
+        "Task " + to_string(count++),
+        description,
+        (TaskStatus)std::uniform_int_distribution<int>(TODO, COMPLETED)(rng),
+        (Priority)std::uniform_int_distribution<int>(URGENT, LOW)(rng),
+        dates[due],
+        dates[start],
+        tags
+      };
+    }
+
+    /**
+     * A function to generate the tasks.
+     * @param db The database to add the tasks to
+     * @param n The number of tasks to generate
+     */
+    void generate_tasks(Database& db, long n) {
+      vector<Task> batch;
+      batch.reserve(n);
+      for (long i = 0; i < n; i++)
+        batch.push_back(generate_task());
+      db.add_tasks(batch);
+    }
+
+    /**
+     * A function to pick a random number.
+     * @param n The number of choices
+     * @returns A number from 0 to n - 1
+     */
+    long pick(long n) {
+      return std::uniform_int_distribution<long>(0, n - 1)(rng);
+    }
+  };
+
+  volatile long sink; /**< A value the timed operations write their results to, so the compiler cannot remove them */
+
+  /**
+   * A function to time an operation until the sample count or time budget runs out.
+   * At least one sample is always taken.
+   * @param name The name of the operation
+   * @param operation The operation to time, called once per sample
+   * @param max_samples The largest number of samples to take
+   * @param budget The time in seconds to spend sampling
+   * @returns The timings of the operation
+   */
+  template <typename Operation>
+  Result measure(const string& name, Operation operation, int max_samples, double budget) {
+    typedef std::chrono::steady_clock Clock;
+    Result result{name, {}, ""};
+    Clock::time_point start = Clock::now();
+    do {
+      Clock::time_point before = Clock::now();
+      operation();
+      result.samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - before).count());
+    } while (result.samples.size() < max_samples && std::chrono::duration<double>(Clock::now() - start).count() < budget);
+    std::cerr << "  " << name << ": " << result.samples.size() << " samples" << std::endl;
+    return result;
+  }
+
+  /**
+   * A function to get a percentile of the samples of an operation.
+   * @param samples The samples, sorted in ascending order
+   * @param p The percentile as a fraction, e.g. 0.99
+   * @returns The smallest sample at or above the percentile
+   */
+  double percentile(const vector<double>& samples, double p) {
+    long index = (long)std::ceil(p * samples.size()) - 1;
+    return samples[std::max(0L, std::min(index, (long)samples.size() - 1))];
+  }
+
+  /**
+   * A function to read a memory figure of this process.
+   * @param field The field of /proc/self/status to read, e.g. "VmRSS"
+   * @returns The value in kilobytes, or -1 if it is not available
+   */
+  long memory_kb(const string& field) {
+    std::ifstream status("/proc/self/status");
+    string line;
+    while (std::getline(status, line)) {
+      if (line.compare(0, field.size() + 1, field + ":") == 0)
+        return std::stol(line.substr(field.size() + 1));
+    }
+    return -1;
+  }
+
+  /**
+   * A function to get the size of the files a database is stored in.
+   * @param db The database
+   * @returns The total size of the manifest and shards in bytes
+   */
+  long store_bytes(Database& db) {
+    long total = 0;
+    for (auto& entry : directory_iterator(db.shard_directory()))
+      total += file_size(entry.path());
+    return total;
+  }
+
+  /**
+   * A function to check if two tasks have the same fields.
+   * @param a The first task
+   * @param b The second task
+   * @returns True if every stored field is the same, false otherwise
+   */
+  bool same_task(const Task& a, const Task& b) {
+    return a.username == b.username && a.title == b.title && a.description == b.description &&
+      a.status == b.status && a.priority == b.priority && a.due_date == b.due_date &&
+      a.start_date == b.start_date && a.tags == b.tags;
+  }
+
+  /**
+   * A function to check that tasks read back unchanged from both store formats and the shared memory layout.
+   * A few tasks with edge case values are checked along with the generated ones: dates in year 0 and 9999, text that
+   * is not a date, out of range status and priority, and words that look like numbers.
+   * @param db The database, with the descriptions and tags of its tasks loaded
+   * @returns True if every task read back equals the task written, false otherwise
+   */
+  bool round_trips(const Database& db) {
+    vector<Task> tasks = db.tasks.to_vector();
+    tasks.push_back(Task{"edge", "  two  spaces ", "007 0 -1 4294967296 1e3", (TaskStatus)9, (Priority)-1, "0000-01-15", "0000-02-29", {"", "a b"}});
+    tasks.push_back(Task{"edge", "", "", TODO, NO_PRIORITY, "9999-12-31", "not a date", {}});
+    tasks.push_back(Task{"edge", "Task 1", "", (TaskStatus)0, (Priority)7, "1969-12-31", "0000-03-01", {"x"}});
+
+    // The compact binary format
+    vector<const Task*> block;
+    for (int i = 0; i < tasks.size(); i++) block.push_back(&tasks[i]);
+    string packed;
+    Helper::Packed::write_tasks(packed, block);
+    vector<Task> unpacked;
+    const char* p = packed.data();
+    if (!Helper::Packed::read_tasks(p, p + packed.size(), unpacked) || unpacked.size() != tasks.size()) return false;
+
+    // The shared memory layout
+    vector<User> shared_users;
+    vector<Task> shared_tasks;
+    if (!Shared::decode(Shared::encode(db.users, tasks), shared_users, shared_tasks) || shared_tasks.size() != tasks.size()) return false;
+    for (int i = 0; i < db.users.size(); i++) {
+      if (shared_users[i].username != db.users[i].username || shared_users[i].password != db.users[i].password) return false;
+    }
+
+    // The json format
+    for (int i = 0; i < tasks.size(); i++) {
+      string json;
+      Helper::Json::write_task(json, tasks[i]);
+      Task parsed;
+      const char* q = json.data();
+      if (!Helper::Json::read_task(q, q + json.size(), parsed)) return false;
+      if (!same_task(unpacked[i], tasks[i]) || !same_task(parsed, tasks[i]) || !same_task(shared_tasks[i], tasks[i])) return false;
+    }
+    return true;
+  }
+
+  /**
+   * A function to check the scheduler and the date indexes against a scan of every task, after random edits.
+   * A small database is added to, edited and deleted from at random, which moves tasks between heap slots and shifts
+   * the positions after each deletion. Every few edits, the next tasks and date views of each user are compared with
+   * the tasks sorted from scratch.
+   * @param seed The seed of the random edits
+   * @returns True if every answer matched, false otherwise
+   */
+  bool schedules(unsigned seed) {
+    std::mt19937 rng(seed);
+    auto pick = [&](int min, int max) { return std::uniform_int_distribution<int>(min, max)(rng); };
+    const vector<string> usernames = { "a", "b", "c" };
+    Manager manager = Manager{ User{"", ""}, Database{ vector<User>{}, vector<Task>{} } };
+    Database& db = manager.db;
+    auto generate = [&](const string& username) {
+      return Task{ username, "", "", (TaskStatus)pick(TODO, COMPLETED), (Priority)pick(URGENT, LOW),
+        Helper::Date::add_days("2026-01-01", pick(0, 39)), Helper::Date::add_days("2026-01-01", pick(0, 39)), {} };
+    };
+
+    for (int step = 0; step < 20000; step++) {
+      int action = pick(0, 9);
+      if (action < 3 || db.tasks.size() < 5) db.add_task(generate(usernames[pick(0, usernames.size() - 1)]));
+      else if (action < 7) {
+        int id = pick(0, db.tasks.size() - 1);
+        Task task = generate(db.tasks[id].username);
+        if (pick(0, 1)) task.due_date = db.tasks[id].due_date;
+        db.update_task(id, task);
+      }
+      else db.delete_task(pick(0, db.tasks.size() - 1));
+      if (step % 97 != 0) continue;
+
+      for (int u = 0; u < usernames.size(); u++) {
+        manager.user = User{usernames[u], ""};
+        manager.is_logged_in = true;
+        vector<int> all, open;
+        for (int i = 0; i < db.tasks.size(); i++) {
+          if (db.tasks[i].username != usernames[u]) continue;
+          all.push_back(i);
+          if (db.tasks[i].status != COMPLETED) open.push_back(i);
+        }
+
+        std::sort(open.begin(), open.end(), [&](int a, int b) {
+          const Task& x = db.tasks[a];
+          const Task& y = db.tasks[b];
+          return std::make_tuple((int)x.priority, x.due_date, x.status == IN_PROGRESS ? 0 : 1, a) <
+            std::make_tuple((int)y.priority, y.due_date, y.status == IN_PROGRESS ? 0 : 1, b);
+        });
+        open.resize(std::min<size_t>(open.size(), 10));
+        if (manager.next_tasks(10) != open) return false;
+
+        // Tasks with the same date may be in any order, so the views are checked for order and then compared as sets
+        string Task::*fields[2] = { &Task::due_date, &Task::start_date };
+        vector<int> views[2] = { manager.tasks_by_due_date(), manager.tasks_by_start_date() };
+        for (int f = 0; f < 2; f++) {
+          auto by_date = [&](int a, int b) { return db.tasks[a].*fields[f] < db.tasks[b].*fields[f]; };
+          if (!std::is_sorted(views[f].begin(), views[f].end(), by_date)) return false;
+          std::sort(views[f].begin(), views[f].end());
+          if (views[f] != all) return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * A function to run the benchmarks on a database of one size.
+   * @param tasks The number of tasks to generate
+   * @param options The options of the run
+   * @returns The results of the run as a json object
+   */
+  string run(long tasks, const Options& options) {
+    long users = options.users > 0 ? options.users : std::max(10L, tasks / 100);
+    std::cerr << "Generating " << tasks << " tasks for " << users << " users" << std::endl;
+
+    Generator generator(users, options.seed);
+    Manager manager = Manager{ User{"", ""}, Database{ vector<User>{}, vector<Task>{} } };
+    manager.db.file_name = "bench.json";
+    manager.db.set_packed(options.packed);
+    auto start = std::chrono::steady_clock::now();
+    generator.generate_users(manager.db);
+    generator.generate_tasks(manager.db, tasks);
+    double generate_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long rss_kb = memory_kb("VmRSS");
+    bool round_trip = round_trips(manager.db);
+    if (!round_trip) std::cerr << "  Tasks did not read back unchanged from the store formats or the shared memory layout" << std::endl;
+    bool schedule = schedules(options.seed);
+    if (!schedule) std::cerr << "  The scheduler or date indexes disagreed with a scan of the tasks" << std::endl;
+
+    // The views are for the user with the most tasks
+    manager.user = manager.db.users[0];
+    manager.is_logged_in = true;
+    Database& db = manager.db;
+    double budget = options.budget;
+    vector<Result> results;
+
+    results.push_back(measure("save_data", [&]() {
+      db.dirty_shards.assign(db.shard_count, true);
+      db.users_dirty = true;
+      db.save_data();
+    }, 5, budget));
+    long bytes = store_bytes(db);
+    results.push_back(measure("load_data", [&]() {
+      Database loaded = Database{ vector<User>{}, vector<Task>{} };
+      loaded.file_name = db.file_name;
+      loaded.load_data();
+    }, 5, budget));
+
+    results.push_back(measure("save_data_one_change", [&]() {
+      manager.complete_task(generator.pick(db.tasks.size()));
+      db.save_data();
+    }, 20, budget));
+
+    // Edits made while a full save is writing in the background
+    db.dirty_shards.assign(db.shard_count, true);
+    db.begin_save();
+    results.push_back(measure("edit_during_save", [&]() {
+      manager.complete_task(generator.pick(db.tasks.size()));
+    }, 1000, budget));
+    db.finish_save();
+
+    results.push_back(measure("login_user", [&]() {
+      long rank = generator.pick(users);
+      sink = manager.login_user(User{Generator::username(rank), "password" + to_string(rank)});
+    }, 1000, budget));
+    long registered = 0;
+    results.push_back(measure("register_user", [&]() {
+      sink = manager.register_user(User{"bench" + to_string(registered++), "password"});
+    }, 1000, budget));
+
+    results.push_back(measure("view_all", [&]() {
+      long count = 0;
+      for (long i = 0; i < db.tasks.size(); i++) {
+        if (db.tasks[i].username == manager.user.username) count++;
+      }
+      sink = count;
+    }, 1000, budget));
+    results.push_back(measure("view_by_status", [&]() {
+      vector<Task> todo, in_progress, completed;
+      manager.group_by_status(todo, in_progress, completed);
+      sink = todo.size();
+    }, 1000, budget));
+    results.push_back(measure("view_by_priority", [&]() {
+      vector<Task> urgent, high, normal, low;
+      manager.group_by_priority(urgent, high, normal, low);
+      sink = urgent.size();
+    }, 1000, budget));
+    results.push_back(measure("view_by_due_date", [&]() { sink = manager.tasks_by_due_date().size(); }, 1000, budget));
+    results.push_back(measure("view_by_start_date", [&]() { sink = manager.tasks_by_start_date().size(); }, 1000, budget));
+    results.push_back(measure("view_overdue", [&]() { sink = manager.overdue_tasks().size(); }, 1000, budget));
+    results.push_back(measure("view_due_soon", [&]() { sink = manager.due_soon_tasks(7).size(); }, 1000, budget));
+    results.push_back(measure("next_tasks", [&]() { sink = manager.next_tasks(10).size(); }, 1000, budget));
+
+    results.push_back(measure("add_task", [&]() {
+      Task task = generator.generate_task();
+      manager.add_task(task);
+    }, 1000, budget));
+    results.push_back(measure("complete_task", [&]() { manager.complete_task(generator.pick(db.tasks.size())); }, 1000, budget));
+    results.push_back(measure("delete_task", [&]() { db.delete_task(generator.pick(db.tasks.size())); }, 100, budget));
+    results.push_back(measure("bulk_reprioritize_overdue", [&]() {
+      sink = manager.reprioritize_overdue((Priority)(URGENT + generator.pick(4)));
+    }, 20, budget));
+    results.push_back(measure("bulk_complete_tagged", [&]() {
+      sink = manager.complete_tagged("tag" + to_string(generator.pick(Generator::TAG_COUNT)));
+    }, 20, budget));
+    results.push_back(measure("bulk_delete_completed", [&]() {
+      sink = manager.delete_completed_before(Helper::Date::add_days(Helper::Date::today(), -Generator::DATE_OFFSET / 2));
+    }, 1, budget));
+
+    // Publishing to shared memory and reading it back as another process would
+    string region = "/tasky-bench-" + to_string(getpid());
+    if (db.share(region)) {
+      results.push_back(measure("shared_publish", [&]() {
+        manager.complete_task(generator.pick(db.tasks.size()));
+        db.publish();
+      }, 20, budget));
+      Shared::Reader reader;
+      string data;
+      uint64_t version;
+      if (reader.open(region)) results.push_back(measure("shared_read", [&]() {
+        vector<User> users;
+        vector<Task> tasks;
+        sink = reader.read(data, version) && Shared::decode(data, users, tasks) ? tasks.size() : 0;
+      }, 100, budget));
+      db.shared.reset();
+      Shared::Writer::remove(region);
+    }
+    else results.push_back(Result{"shared_publish", {}, "the shared memory region could not be opened"});
+
+    // Format the results as a json object
+    string out = "{\"tasks\":" + to_string(tasks) + ",\"users\":" + to_string(users);
+    out += ",\"generate_seconds\":" + to_string(generate_seconds);
+    out += ",\"rss_kb\":" + to_string(rss_kb);
+    out += ",\"peak_rss_kb\":" + to_string(memory_kb("VmHWM"));
+    out += ",\"format\":" + string(options.packed ? "\"packed\"" : "\"json\"");
+    out += ",\"store_bytes\":" + to_string(bytes);
+    out += ",\"round_trip\":" + string(round_trip ? "true" : "false");
+    out += ",\"schedule\":" + string(schedule ? "true" : "false");
+    out += ",\"operations\":{";
+    for (int i = 0; i < results.size(); i++) {
+      Result& result = results[i];
+      if (i > 0) out += ",";
+      Helper::Json::write_string(out, result.name);
+      if (!result.skipped.empty()) {
+        out += ":{\"skipped\":";
+        Helper::Json::write_string(out, result.skipped);
+        out += "}";
+        continue;
+      }
+      std::sort(result.samples.begin(), result.samples.end());
+      out += ":{\"samples\":" + to_string(result.samples.size());
+      out += ",\"p50_ns\":" + to_string((long)percentile(result.samples, 0.5));
+      out += ",\"p99_ns\":" + to_string((long)percentile(result.samples, 0.99));
+      out += ",\"max_ns\":" + to_string((long)result.samples.back()) + "}";
+    }
+    out += "}}";
+    return out;
+  }
+
+  /**
+   * A function to read the options from the command line.
+   * @param argc The number of arguments
+   * @param argv The arguments
+   * @param options The options read
+   * @returns True if the arguments are valid, false otherwise
+   */
+  bool read_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (i + 1 >= argc) return false;
+      string value = argv[++i];
+      if (arg == "--tasks") {
+        options.sizes.clear();
+        vector<string> sizes = split(value, ',');
+        for (int j = 0; j < sizes.size(); j++) options.sizes.push_back(std::stol(sizes[j]));
+      }
+      else if (arg == "--users") options.users = std::stol(value);
+      else if (arg == "--budget") options.budget = std::stod(value);
+      else if (arg == "--seed") options.seed = std::stoul(value);
+      else if (arg == "--out") options.out = value;
+      else if (arg == "--format" && (value == "json" || value == "packed")) options.packed = value == "packed";
+      else return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Bench::Options options;
+  if (!Bench::read_options(argc, argv, options)) {
+    write_line("Usage: bench [--tasks 10000,1000000,10000000] [--users n] [--budget seconds] [--seed n] [--format json|packed] [--out file]");
+    return 1;
+  }
+
+  string out = "{\"benchmark\":\"tasky\",\"date\":\"" + Helper::Date::today() + "\",\"runs\":[";
+  for (int i = 0; i < options.sizes.size(); i++) {
+    if (i > 0) out += ",";
+    out += Bench::run(options.sizes[i], options);
+  }
+  out += "]}\n";
+
+  if (options.out.empty()) std::cout << out;
+  else std::ofstream(options.out) << out;
+  METRICS_DUMP_FROM_ENV();
+  return 0;
+}
+
+// clang++ -O2 bench.cpp -o bench -lstdc++fs -l SplashKit && ./bench --tasks 10000,1000000,10000000 --out bench-results.json
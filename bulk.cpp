@@ -0,0 +1,490 @@
+#define TASKY_NO_MAIN
+#include "tasky.cpp"
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
+/**
+ * A namespace to provide bulk import and export of tasks in CSV and NDJSON files.
+ * The input file is read into memory once and split into chunks on line boundaries.
+ * Each chunk is parsed and validated on its own thread, and the results are appended to the database in one batch.
+ */
+namespace Bulk {
+  /**
+   * An enum representing the file formats supported by the bulk tool.
+   */
+  enum Format {
+    CSV = 1, /**< Comma separated values with a header row */
+    NDJSON = 2, /**< One json object per line */
+  };
+
+  /**
+   * The columns of a task in a CSV file, in the order they are exported.
+   * Tags are written as a single column separated by commas, the same as when they are entered in the menu.
+   */
+  const vector<string> COLUMNS = { "username", "title", "description", "status", "priority", "due_date", "start_date", "tags" };
+
+  /**
+   * A struct representing a part of the input file to be parsed by one thread.
+   */
+  struct Chunk {
+    const char* begin; /**< The first character of the chunk */
+    const char* end; /**< One past the last character of the chunk */
+    int first_line; /**< The line number of the first line in the chunk */
+
+    vector<Task> tasks; /**< The valid tasks read from the chunk */
+    vector<int> lines; /**< The line number of each of the tasks */
+    vector<int> rejected; /**< The line numbers of the rows that could not be imported */
+  };
+
+  /**
+   * A function to get the number of threads to use.
+   * @returns The number of hardware threads, or 1 if it is not known
+   */
+  int thread_count() {
+    int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+  }
+
+  /**
+   * A function to get the format of a file from its extension.
+   * @param path The path of the file
+   * @returns The format of the file, NDJSON unless the extension is .csv
+   */
+  Format format_of(const string& path) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) return CSV;
+    return NDJSON;
+  }
+
+  /**
+   * A function to split a buffer into chunks of roughly equal size on line boundaries.
+   * In CSV files a newline inside a quoted field does not end a row, so the quotes are tracked while scanning.
+   * @param begin The start of the buffer
+   * @param end The end of the buffer
+   * @param first_line The line number of the first line in the buffer
+   * @param count The number of chunks to split into
+   * @param format The format of the buffer
+   * @returns The chunks, which cover the whole buffer
+   */
+  vector<Chunk> split_chunks(const char* begin, const char* end, int first_line, int count, Format format) {
+    vector<Chunk> chunks;
+    size_t target = (end - begin) / count + 1;
+    const char* start = begin;
+    const char* p = begin;
+    int line = first_line;
+    int start_line = first_line;
+    bool in_quotes = false;
+
+    while (p < end) {
+      if (format == CSV && *p == '"') in_quotes = !in_quotes;
+      else if (*p == '\n') {
+        line++; // Every newline counts, as read_csv_field counts those inside quotes too
+        if (!in_quotes && p + 1 - start >= target) {
+          chunks.push_back(Chunk{start, p + 1, start_line, {}, {}, {}});
+          start = p + 1;
+          start_line = line;
+        }
+      }
+      p++;
+    }
+    if (start < end) chunks.push_back(Chunk{start, end, start_line, {}, {}, {}});
+    return chunks;
+  }
+
+  /**
+   * A function to read one field of a CSV row.
+   * @param p The current position, advanced past the field and its separator
+   * @param end The end of the buffer
+   * @param out The value of the field, with quotes removed
+   * @param line The current line number, advanced past newlines inside quoted fields
+   * @returns True if there are more fields in the row, false if the row has ended
+   */
+  bool read_csv_field(const char*& p, const char* end, string& out, int& line) {
+    out.clear();
+    if (p < end && *p == '"') {
+      p++;
+      while (p < end) {
+        if (*p == '"') {
+          if (p + 1 < end && p[1] == '"') { // An escaped quote
+            out += '"';
+            p += 2;
+            continue;
+          }
+          p++;
+          break;
+        }
+        if (*p == '\n') line++;
+        out += *p++;
+      }
+    }
+    else {
+      const char* start = p;
+      while (p < end && *p != ',' && *p != '\n' && *p != '\r') p++;
+      out.append(start, p - start);
+    }
+
+    if (p < end && *p == ',') {
+      p++;
+      return true;
+    }
+    // Consume the end of the row
+    if (p < end && *p == '\r') p++;
+    if (p < end && *p == '\n') p++;
+    return false;
+  }
+
+  /**
+   * A function to read an integer field of a CSV row.
+   * @param value The value of the field
+   * @param out The integer read
+   * @returns True if the field is a whole number, false otherwise
+   */
+  bool parse_integer(const string& value, int& out) {
+    if (value.empty() || value.size() > 9) return false;
+    out = 0;
+    for (int i = 0; i < value.size(); i++) {
+      if (value[i] < '0' || value[i] > '9') return false;
+      out = out * 10 + (value[i] - '0');
+    }
+    return true;
+  }
+
+  /**
+   * A function to check the fields of a task that are not dates.
+   * @param task The task to check
+   * @returns True if the task has a username, a status and a priority in range, false otherwise
+   */
+  bool is_task_valid(const Task& task) {
+    return !task.username.empty() &&
+      task.status >= TODO && task.status <= NO_STATUS &&
+      task.priority >= URGENT && task.priority <= NO_PRIORITY;
+  }
+
+  /**
+   * A function to parse the rows of a CSV chunk into tasks.
+   * @param chunk The chunk to parse
+   * @param columns The position of each of the COLUMNS in a row, or -1 if it is missing
+   */
+  void parse_csv(Chunk& chunk, const vector<int>& columns) {
+    const char* p = chunk.begin;
+    int line = chunk.first_line;
+    vector<string> fields;
+    string field;
+
+    while (p < chunk.end) {
+      int row_line = line;
+      fields.clear();
+      bool more = true;
+      while (more) {
+        more = read_csv_field(p, chunk.end, field, line);
+        fields.push_back(field);
+      }
+      line++;
+      if (fields.size() == 1 && fields[0].empty()) continue; // Skip blank lines
+
+      // Look up each column by its position in the header
+      string* values[8] = {};
+      bool ok = true;
+      for (int i = 0; i < 8; i++) {
+        if (columns[i] >= 0 && columns[i] < fields.size()) values[i] = &fields[columns[i]];
+      }
+      int status = NO_STATUS, priority = NO_PRIORITY;
+      if (values[3] && !values[3]->empty()) ok = ok && parse_integer(*values[3], status);
+      if (values[4] && !values[4]->empty()) ok = ok && parse_integer(*values[4], priority);
+      if (!ok) {
+        chunk.rejected.push_back(row_line);
+        continue;
+      }
+
+      Task task{
+        values[0] ? *values[0] : "",
+        values[1] ? *values[1] : "",
+        values[2] ? *values[2] : "",
+        (TaskStatus)status,
+        (Priority)priority,
+        values[5] ? *values[5] : "",
+        values[6] ? *values[6] : "",
+        values[7] && !values[7]->empty() ? split(*values[7], ',') : vector<string>{}
+      };
+      chunk.tasks.push_back(std::move(task));
+      chunk.lines.push_back(row_line);
+    }
+  }
+
+  /**
+   * A function to parse the lines of an NDJSON chunk into tasks.
+   * @param chunk The chunk to parse
+   */
+  void parse_ndjson(Chunk& chunk) {
+    const char* p = chunk.begin;
+    int line = chunk.first_line;
+
+    while (p < chunk.end) {
+      const char* eol = (const char*)std::memchr(p, '\n', chunk.end - p);
+      if (!eol) eol = chunk.end;
+
+      // Skip blank lines
+      const char* q = p;
+      while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+      if (q < eol) {
+        Task task;
+        if (Helper::Json::read_task(q, eol, task)) {
+          chunk.tasks.push_back(std::move(task));
+          chunk.lines.push_back(line);
+        }
+        else chunk.rejected.push_back(line);
+      }
+
+      p = eol + 1;
+      line++;
+    }
+  }
+
+  /**
+   * A function to parse and validate one chunk.
+   * The dates of the chunk are validated as a batch once all its rows are parsed.
+   * Invalid tasks are removed from the chunk in a single pass and their line numbers recorded.
+   * @param chunk The chunk to parse
+   * @param format The format of the chunk
+   * @param columns The position of each CSV column, unused for NDJSON
+   */
+  void process_chunk(Chunk& chunk, Format format, const vector<int>& columns) {
+    if (format == CSV) parse_csv(chunk, columns);
+    else parse_ndjson(chunk);
+
+    vector<bool> valid;
+    Helper::Date::validate_dates(chunk.tasks, valid);
+
+    int kept = 0;
+    for (int i = 0; i < chunk.tasks.size(); i++) {
+      if (valid[i] && is_task_valid(chunk.tasks[i])) {
+        if (kept != i) {
+          chunk.tasks[kept] = std::move(chunk.tasks[i]);
+          chunk.lines[kept] = chunk.lines[i];
+        }
+        kept++;
+      }
+      else chunk.rejected.push_back(chunk.lines[i]);
+    }
+    chunk.tasks.resize(kept);
+    chunk.lines.resize(kept);
+  }
+
+  /**
+   * A function to report the rows that were skipped.
+   * @param lines The line numbers of the rows
+   * @param reason Why the rows were skipped, e.g. "invalid rows"
+   */
+  void report_skipped(vector<int>& lines, const string& reason) {
+    if (lines.empty()) return;
+    std::sort(lines.begin(), lines.end());
+    string list = "";
+    for (int i = 0; i < lines.size() && i < 10; i++)
+      list += (i > 0 ? ", " : "") + to_string(lines[i]);
+    if (lines.size() > 10) list += ", ...";
+    write_line("Skipped " + to_string((int)lines.size()) + " " + reason + " (lines " + list + ").");
+  }
+
+  /**
+   * A function to import the tasks in a file into the database.
+   * Tasks with missing usernames, invalid dates or out of range fields are skipped and reported.
+   * Tasks of users that are not in the database are skipped and reported too, since no login could reach them.
+   * @param db The database to import into
+   * @param path The path of the file to import
+   * @param format The format of the file
+   * @returns The number of tasks imported, or -1 if the file could not be read
+   */
+  int import_tasks(Database& db, const string& path, Format format) {
+    string data;
+    if (!Database::read_file(path, data)) return -1;
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    int first_line = 1;
+
+    // Map the header row of a CSV file to the columns of a task
+    vector<int> columns(COLUMNS.size(), -1);
+    if (format == CSV) {
+      vector<string> header;
+      string field;
+      bool more = true;
+      while (more) {
+        more = read_csv_field(begin, end, field, first_line);
+        header.push_back(field);
+      }
+      first_line++;
+      for (int i = 0; i < header.size(); i++) {
+        for (int j = 0; j < COLUMNS.size(); j++) {
+          if (header[i] == COLUMNS[j]) columns[j] = i;
+        }
+      }
+    }
+
+    // Parse the chunks in parallel
+    vector<Chunk> chunks = split_chunks(begin, end, first_line, thread_count(), format);
+    vector<std::thread> threads;
+    for (int i = 0; i < chunks.size(); i++)
+      threads.push_back(std::thread(process_chunk, std::ref(chunks[i]), format, std::cref(columns)));
+    for (int i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    // Append the tasks of known users to the database in one batch
+    std::unordered_set<string> usernames;
+    for (int i = 0; i < db.users.size(); i++) usernames.insert(db.users[i].username);
+    size_t total = 0;
+    for (int i = 0; i < chunks.size(); i++) total += chunks[i].tasks.size();
+    vector<Task> batch;
+    batch.reserve(total);
+    vector<int> rejected, unknown;
+    for (int i = 0; i < chunks.size(); i++) {
+      for (int j = 0; j < chunks[i].tasks.size(); j++) {
+        if (usernames.count(chunks[i].tasks[j].username)) batch.push_back(std::move(chunks[i].tasks[j]));
+        else unknown.push_back(chunks[i].lines[j]);
+      }
+      rejected.insert(rejected.end(), chunks[i].rejected.begin(), chunks[i].rejected.end());
+    }
+    int imported = batch.size();
+    db.add_tasks(batch);
+
+    report_skipped(rejected, "invalid rows");
+    report_skipped(unknown, "rows of unknown users");
+    return imported;
+  }
+
+  /**
+   * A function to append a CSV field to a buffer, quoting it if needed.
+   * @param out The buffer to append to
+   * @param value The value of the field
+   */
+  void write_csv_field(string& out, const string& value) {
+    if (value.find_first_of(",\"\r\n") == string::npos) {
+      out += value;
+      return;
+    }
+    out += '"';
+    for (int i = 0; i < value.size(); i++) {
+      if (value[i] == '"') out += '"';
+      out += value[i];
+    }
+    out += '"';
+  }
+
+  /**
+   * A function to append a task to a buffer as a CSV row.
+   * @param out The buffer to append to
+   * @param task The task to append
+   */
+  void write_csv_row(string& out, const Task& task) {
+    write_csv_field(out, task.username);
+    out += ',';
+    write_csv_field(out, task.title);
+    out += ',';
+    write_csv_field(out, task.description);
+    out += ',' + to_string((int)task.status) + ',' + to_string((int)task.priority) + ',';
+    write_csv_field(out, task.due_date);
+    out += ',';
+    write_csv_field(out, task.start_date);
+    out += ',';
+    string tags = "";
+    for (int i = 0; i < task.tags.size(); i++) {
+      if (i > 0) tags += ',';
+      tags += task.tags[i];
+    }
+    write_csv_field(out, tags);
+    out += '\n';
+  }
+
+  /**
+   * A function to export the tasks in the database to a file.
+   * The descriptions and tags are loaded first, then the tasks are formatted in parallel ranges and written to the file in order.
+   * @param db The database to export
+   * @param path The path of the file to write
+   * @param format The format of the file
+   * @returns The number of tasks exported, or -1 if the tasks could not be read or the file could not be written
+   */
+  int export_tasks(Database& db, const string& path, Format format) {
+    if (!db.load_bodies()) return -1;
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return -1;
+
+    int count = thread_count();
+    vector<string> parts(count);
+    vector<std::thread> threads;
+    size_t size = db.tasks.size();
+    for (int i = 0; i < count; i++) {
+      threads.push_back(std::thread([&db, &parts, format, count, size, i]() {
+        size_t first = size * i / count, last = size * (i + 1) / count;
+        string& out = parts[i];
+        for (size_t j = first; j < last; j++) {
+          if (format == CSV) write_csv_row(out, db.tasks[j]);
+          else {
+            Helper::Json::write_task(out, db.tasks[j]);
+            out += '\n';
+          }
+        }
+      }));
+    }
+    for (int i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    if (format == CSV) {
+      string header = "";
+      for (int i = 0; i < COLUMNS.size(); i++)
+        header += (i > 0 ? "," : "") + COLUMNS[i];
+      file << header << '\n';
+    }
+    for (int i = 0; i < parts.size(); i++)
+      file.write(parts[i].data(), parts[i].size());
+    return file ? size : -1;
+  }
+}
+
+/**
+ * A function to display how to use the bulk tool.
+ */
+void display_usage() {
+  write_line("Usage: bulk import <file> [--format csv|ndjson]");
+  write_line("       bulk export <file> [--format csv|ndjson]");
+  write_line("The format defaults to csv for files ending in .csv, and ndjson otherwise.");
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 3 && !(argc == 5 && string(argv[3]) == "--format")) {
+    display_usage();
+    return 1;
+  }
+  string command = argv[1];
+  string path = argv[2];
+  Bulk::Format format = Bulk::format_of(path);
+  if (argc == 5) format = string(argv[4]) == "csv" ? Bulk::CSV : Bulk::NDJSON;
+
+  Database db = Database{ vector<User>{}, vector<Task>{} };
+  if (!db.load_data()) {
+    write_line("Could not read the whole store.");
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int count;
+  if (command == "import") count = Bulk::import_tasks(db, path, format);
+  else if (command == "export") count = Bulk::export_tasks(db, path, format);
+  else {
+    display_usage();
+    return 1;
+  }
+  if (count == -1) {
+    write_line("Could not " + command + " " + path + ".");
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  write_line(command + "ed " + to_string(count) + " tasks in " + to_string(seconds) + "s (" + to_string((long)(count / (seconds > 0 ? seconds : 1))) + " tasks/s).");
+  if (command == "import" && !db.save_data()) {
+    write_line("Could not save the imported tasks.");
+    return 1;
+  }
+  METRICS_DUMP_FROM_ENV();
+}
+
+// clang++ bulk.cpp -o bulk -lstdc++fs -l SplashKit -pthread && ./bulk import tasks.csv
@@ -1,7 +1,10 @@
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include <curl/curl.h>
 #include <splashkit.h>
+#include "metrics.h"
+#include "shared.h"
 
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
   ((std::string*)userp)->append((char*)contents, size * nmemb);
@@ -13,7 +16,34 @@ struct User {
   std::string password;
 };
 
+// Read the users from the shared memory region published by a local tasky, without going through the server
+bool read_shared_users(const char* region, vector<User>& users) {
+  Shared::Reader reader;
+  std::string data;
+  uint64_t version;
+  if (!reader.open(region) || !reader.read(data, version)) return false;
+
+  const char* p = data.data();
+  return Shared::decode_users(p, p + data.size(), users);
+}
+
 int main() {
+  // Set TASKY_SHM to the region tasky publishes to, e.g. /tasky, to read from it instead of the server
+  const char* region = getenv("TASKY_SHM");
+  vector<User> shared_users;
+  if (region && *region) {
+    bool found;
+    {
+      METRICS_TIMER("shared_read");
+      found = read_shared_users(region, shared_users);
+    }
+    if (found) {
+      if (!shared_users.empty()) write_line(shared_users[0].username);
+      METRICS_DUMP_FROM_ENV();
+      return 0;
+    }
+  }
+
   CURL* curl;
   CURLcode res;
   std::string readBuffer;
@@ -24,9 +54,13 @@ int main() {
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
 
-    res = curl_easy_perform(curl);
+    {
+      METRICS_TIMER("http_request");
+      res = curl_easy_perform(curl);
+    }
     if (res != CURLE_OK) {
       fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+      METRICS_COUNT("http_errors");
     }
 
     curl_easy_cleanup(curl);
@@ -52,5 +86,5 @@ int main() {
 
     std::cout << "Response data: " << readBuffer << std::endl;
   }
-
+  METRICS_DUMP_FROM_ENV();
 }
\ No newline at end of file
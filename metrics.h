@@ -0,0 +1,356 @@
+#ifndef TASKY_METRICS_H
+#define TASKY_METRICS_H
+
+/**
+ * Hot path instrumentation shared by tasky and the companion tools.
+ *
+ * Compile with -D TASKY_METRICS to enable it. Without the flag every macro expands to nothing,
+ * so instrumented code is identical to uninstrumented code.
+ *
+ * METRICS_TIMER("name") times the rest of the enclosing scope.
+ * METRICS_COUNT("name") adds one to a counter.
+ * METRICS_DUMP_FROM_ENV() writes all metrics to the file named by the TASKY_METRICS_FILE environment
+ * variable, as json if the name ends in .json and in the Prometheus text format otherwise.
+ */
+#ifdef TASKY_METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A namespace to provide scoped timers and counters stored in per-thread histograms.
+ * Each thread records into its own block, so recording never takes a lock or a locked instruction.
+ * Blocks are only read when the metrics are dumped, and are summed across threads then.
+ * When a thread exits its metrics are added to a retired total and its block is reused by the next thread,
+ * so short lived threads such as background saves do not add a block each.
+ */
+namespace Metrics {
+  const int MAX_METRICS = 64; /**< The largest number of distinct metrics */
+  const int BUCKETS = 40; /**< The number of histogram buckets; bucket b holds times in [2^b, 2^(b+1)) nanoseconds */
+
+  /**
+   * An enum representing the kinds of metric.
+   */
+  enum Kind {
+    TIMER = 1, /**< A histogram of durations */
+    COUNTER = 2, /**< A count of events */
+  };
+
+  /**
+   * A struct representing a histogram of durations, or a counter when only the count is used.
+   * Only the owning thread writes to a histogram, so updates are a relaxed load and store rather than a locked add.
+   * Other threads may read it at any time and see a slightly stale value.
+   */
+  struct Histogram {
+    std::atomic<uint64_t> count{0}; /**< The number of events */
+    std::atomic<uint64_t> sum{0}; /**< The total duration in nanoseconds */
+    std::atomic<uint64_t> buckets[BUCKETS] = {}; /**< The number of events in each bucket */
+
+    /**
+     * A function to add to a value owned by this thread.
+     * @param value The value to add to
+     * @param n The amount to add
+     */
+    static void add(std::atomic<uint64_t>& value, uint64_t n) {
+      value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    /**
+     * A function to record a duration.
+     * @param ns The duration in nanoseconds
+     */
+    void record(uint64_t ns) {
+      int bucket = ns > 1 ? 63 - __builtin_clzll(ns) : 0;
+      if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+      add(count, 1);
+      add(sum, ns);
+      add(buckets[bucket], 1);
+    }
+    /**
+     * A function to move the events of this histogram into another, leaving this one empty.
+     * Only called with the registry locked, by the thread that owns this histogram.
+     * @param to The histogram to add the events to
+     */
+    void move_to(Histogram& to) {
+      add(to.count, count.exchange(0, std::memory_order_relaxed));
+      add(to.sum, sum.exchange(0, std::memory_order_relaxed));
+      for (int b = 0; b < BUCKETS; b++) add(to.buckets[b], buckets[b].exchange(0, std::memory_order_relaxed));
+    }
+  };
+
+  /**
+   * A struct representing the metrics recorded by one thread.
+   */
+  struct ThreadBlock {
+    Histogram metrics[MAX_METRICS]; /**< The histogram of each metric, by id */
+  };
+
+  /**
+   * A struct representing the names of the metrics and the blocks of the threads recording them.
+   * The lock is only taken when a metric or thread is first seen, when a thread exits, and when dumping.
+   */
+  struct Registry {
+    std::mutex mutex; /**< The lock for the fields below */
+    std::vector<std::string> names; /**< The name of each metric, by id */
+    std::vector<Kind> kinds; /**< The kind of each metric, by id */
+    std::vector<std::unique_ptr<ThreadBlock>> blocks; /**< Every block, in use by a thread or free; there are never more than the most threads alive at once */
+    std::vector<ThreadBlock*> free_blocks; /**< The empty blocks left by threads that have exited */
+    ThreadBlock retired; /**< The metrics recorded by threads that have exited */
+  };
+
+  /**
+   * A function to get the registry.
+   * @returns The registry shared by all threads
+   */
+  inline Registry& registry() {
+    static Registry instance;
+    return instance;
+  }
+
+  /**
+   * A function to get the id of a metric, registering it if it is new.
+   * The macros call this once per call site and keep the id in a static.
+   * @param name The name of the metric
+   * @param kind The kind of the metric
+   * @returns The id of the metric, or -1 if there are already MAX_METRICS metrics
+   */
+  inline int id(const char* name, Kind kind) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (int i = 0; i < r.names.size(); i++) {
+      if (r.names[i] == name) return i;
+    }
+    if (r.names.size() >= MAX_METRICS) return -1;
+    r.names.push_back(name);
+    r.kinds.push_back(kind);
+    return r.names.size() - 1;
+  }
+
+  /**
+   * A struct representing the block of the current thread, which is given back when the thread exits.
+   */
+  struct LocalBlock {
+    ThreadBlock* block = nullptr; /**< The block, or nullptr until the thread first records a metric */
+
+    ~LocalBlock() {
+      if (!block) return;
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      for (int i = 0; i < MAX_METRICS; i++) block->metrics[i].move_to(r.retired.metrics[i]);
+      r.free_blocks.push_back(block);
+    }
+  };
+
+  /**
+   * A function to get the block of the current thread, taking a free block or creating one on first use.
+   * @returns The block of the current thread
+   */
+  inline ThreadBlock& local() {
+    thread_local LocalBlock local;
+    if (!local.block) {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      if (!r.free_blocks.empty()) {
+        local.block = r.free_blocks.back();
+        r.free_blocks.pop_back();
+      }
+      else {
+        r.blocks.emplace_back(new ThreadBlock());
+        local.block = r.blocks.back().get();
+      }
+    }
+    return *local.block;
+  }
+
+  /**
+   * A function to add to a counter.
+   * @param id The id of the counter
+   * @param n The amount to add
+   */
+  inline void count(int id, uint64_t n) {
+    if (id >= 0) Histogram::add(local().metrics[id].count, n);
+  }
+
+  /**
+   * A class to time a scope, recording the duration when it is destroyed.
+   */
+  class ScopedTimer {
+    private:
+    int id; /**< The id of the timer */
+    std::chrono::steady_clock::time_point start; /**< The time the scope was entered */
+
+    public:
+    ScopedTimer(int id) : id(id), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+      if (id < 0) return;
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      local().metrics[id].record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+  };
+
+  /**
+   * A struct representing a metric summed across all threads.
+   */
+  struct Total {
+    std::string name; /**< The name of the metric */
+    Kind kind; /**< The kind of the metric */
+    uint64_t count; /**< The number of events */
+    uint64_t sum; /**< The total duration in nanoseconds */
+    uint64_t buckets[BUCKETS]; /**< The number of events in each bucket */
+  };
+
+  /**
+   * A function to add a histogram to a total.
+   * @param total The total to add to
+   * @param h The histogram to add
+   */
+  inline void add_to(Total& total, const Histogram& h) {
+    total.count += h.count.load(std::memory_order_relaxed);
+    total.sum += h.sum.load(std::memory_order_relaxed);
+    for (int b = 0; b < BUCKETS; b++) total.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * A function to sum every metric across the live threads and the threads that have exited.
+   * @returns The totals, by id
+   */
+  inline std::vector<Total> totals() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<Total> result;
+    for (int i = 0; i < r.names.size(); i++) {
+      Total total = { r.names[i], r.kinds[i], 0, 0, {} };
+      add_to(total, r.retired.metrics[i]);
+      for (int j = 0; j < r.blocks.size(); j++) add_to(total, r.blocks[j]->metrics[i]);
+      result.push_back(total);
+    }
+    return result;
+  }
+
+  /**
+   * A function to estimate a percentile of a timer from its buckets.
+   * @param total The timer
+   * @param p The percentile as a fraction, e.g. 0.99
+   * @returns The upper bound in nanoseconds of the bucket the percentile falls in
+   */
+  inline uint64_t percentile(const Total& total, double p) {
+    uint64_t rank = (uint64_t)(p * total.count + 0.5), seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+      seen += total.buckets[b];
+      if (seen >= rank && seen > 0) return 2ULL << b;
+    }
+    return 0;
+  }
+
+  /**
+   * A function to format a duration in seconds without losing precision.
+   * @param ns The duration in nanoseconds
+   * @returns The duration in seconds
+   */
+  inline std::string seconds(uint64_t ns) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", ns / 1e9);
+    return buffer;
+  }
+
+  /**
+   * A function to format all metrics in the Prometheus text format.
+   * Timers become histograms in seconds named tasky_<name>_seconds, counters become tasky_<name>_total.
+   * @returns The formatted metrics
+   */
+  inline std::string to_prometheus() {
+    std::string out;
+    std::vector<Total> all = totals();
+    for (int i = 0; i < all.size(); i++) {
+      const Total& t = all[i];
+      if (t.kind == COUNTER) {
+        std::string name = "tasky_" + t.name + "_total";
+        out += "# TYPE " + name + " counter\n";
+        out += name + " " + std::to_string(t.count) + "\n";
+        continue;
+      }
+      std::string name = "tasky_" + t.name + "_seconds";
+      out += "# TYPE " + name + " histogram\n";
+      uint64_t cumulative = 0;
+      for (int b = 0; b < BUCKETS; b++) {
+        cumulative += t.buckets[b];
+        out += name + "_bucket{le=\"" + seconds(2ULL << b) + "\"} " + std::to_string(cumulative) + "\n";
+      }
+      out += name + "_bucket{le=\"+Inf\"} " + std::to_string(t.count) + "\n";
+      out += name + "_sum " + seconds(t.sum) + "\n";
+      out += name + "_count " + std::to_string(t.count) + "\n";
+    }
+    return out;
+  }
+
+  /**
+   * A function to format all metrics as json.
+   * @returns The formatted metrics
+   */
+  inline std::string to_json() {
+    std::string timers, counters;
+    std::vector<Total> all = totals();
+    for (int i = 0; i < all.size(); i++) {
+      const Total& t = all[i];
+      if (t.kind == COUNTER) {
+        counters += (counters.empty() ? "\"" : ",\"") + t.name + "\":" + std::to_string(t.count);
+        continue;
+      }
+      timers += (timers.empty() ? "\"" : ",\"") + t.name + "\":{\"count\":" + std::to_string(t.count);
+      timers += ",\"sum_ns\":" + std::to_string(t.sum);
+      timers += ",\"p50_ns\":" + std::to_string(percentile(t, 0.5));
+      timers += ",\"p99_ns\":" + std::to_string(percentile(t, 0.99)) + "}";
+    }
+    return "{\"timers\":{" + timers + "},\"counters\":{" + counters + "}}\n";
+  }
+
+  /**
+   * A function to write all metrics to a file.
+   * @param path The path of the file, written as json if it ends in .json and as Prometheus text otherwise
+   * @returns True if the file was written, false otherwise
+   */
+  inline bool dump(const std::string& path) {
+    bool is_json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::ofstream file(path);
+    file << (is_json ? to_json() : to_prometheus());
+    return (bool)file;
+  }
+
+  /**
+   * A function to write all metrics to the file named by the TASKY_METRICS_FILE environment variable.
+   * Nothing is written if the variable is not set.
+   */
+  inline void dump_from_env() {
+    const char* path = std::getenv("TASKY_METRICS_FILE");
+    if (path && *path) dump(path);
+  }
+}
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_TIMER(name) \
+  static const int METRICS_CONCAT(metrics_id_, __LINE__) = Metrics::id(name, Metrics::TIMER); \
+  Metrics::ScopedTimer METRICS_CONCAT(metrics_timer_, __LINE__)(METRICS_CONCAT(metrics_id_, __LINE__))
+#define METRICS_COUNT(name) \
+  do { \
+    static const int metrics_id = Metrics::id(name, Metrics::COUNTER); \
+    Metrics::count(metrics_id, 1); \
+  } while (0)
+#define METRICS_DUMP_FROM_ENV() Metrics::dump_from_env()
+
+#else
+
+#define METRICS_TIMER(name) ((void)0)
+#define METRICS_COUNT(name) ((void)0)
+#define METRICS_DUMP_FROM_ENV() ((void)0)
+
+#endif
+
+#endif
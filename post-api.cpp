@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <curl/curl.h>
+#include "metrics.h"
 
 // Callback function to write the response data to a string
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
@@ -44,11 +45,15 @@ int main() {
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
     // Perform the request, res will get the return code
-    res = curl_easy_perform(curl);
+    {
+      METRICS_TIMER("http_request");
+      res = curl_easy_perform(curl);
+    }
 
     // Check if the request was successful
     if (res != CURLE_OK) {
       fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+      METRICS_COUNT("http_errors");
     }
     else {
       // Output the response data (JSON)
@@ -61,5 +66,6 @@ int main() {
     curl_easy_cleanup(curl);      // Clean up the curl session
   }
 
+  METRICS_DUMP_FROM_ENV();
   return 0;
 }
@@ -0,0 +1,381 @@
+#ifndef TASKY_SHARED_H
+#define TASKY_SHARED_H
+
+/**
+ * A copy of the tasky database in POSIX shared memory, which local tools can read without parsing json or going through http.
+ *
+ * tasky publishes the users and tasks after every change when the TASKY_SHM environment variable names a region, e.g. /tasky.
+ * The region starts with a Header, followed by the data of the current version:
+ *   u32 user count, then for each user: username, password
+ *   u32 task count, then for each task: username, title, description, u32 status, u32 priority, due date, start date,
+ *   u32 tag count, tags
+ * Integers are in the byte order of the machine, and strings are a u32 length followed by the bytes. The status and
+ * priority are stored as they are, even outside the range of their enums, with negative values in two's complement.
+ * encode and decode implement the layout, so the writer and every reader share it.
+ *
+ * There is one writer and any number of readers, and readers never block the writer. The writer makes the sequence
+ * number odd while it copies a new version in, and a reader retries if the sequence number was odd or changed while
+ * it copied the data out (a seqlock). Readers decode their own copy, so they never see a partly written version.
+ * The writer holds an exclusive lock on the region for as long as it has it open, so a second writer is refused.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Shared {
+  const uint64_t MAGIC = 0x324d4853594b5354; /**< "TSKYSHM2" read as a little endian integer, changed with the layout */
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "the header is shared between processes, so its atomics must be lock free");
+
+  /**
+   * A struct representing the start of the region.
+   */
+  struct Header {
+    uint64_t magic; /**< MAGIC once the region is set up */
+    std::atomic<uint64_t> sequence; /**< Twice the number of versions published, plus one while a version is being copied in */
+    std::atomic<uint64_t> capacity; /**< The number of bytes after the header, which only grows */
+    std::atomic<uint64_t> size; /**< The number of bytes of data in the current version */
+  };
+
+  /**
+   * A function to append a u32 to a buffer.
+   * @param out The buffer to append to
+   * @param value The value to append
+   */
+  inline void write_u32(std::string& out, uint32_t value) {
+    out.append((const char*)&value, sizeof(value));
+  }
+  /**
+   * A function to append a string to a buffer.
+   * @param out The buffer to append to
+   * @param value The string to append
+   */
+  inline void write_string(std::string& out, const std::string& value) {
+    write_u32(out, value.size());
+    out += value;
+  }
+  /**
+   * A function to read a u32 from a buffer.
+   * @param p The current position, advanced past the value
+   * @param end The end of the buffer
+   * @param out The value read
+   * @returns True if the value was read, false if the buffer is too short
+   */
+  inline bool read_u32(const char*& p, const char* end, uint32_t& out) {
+    if (end - p < (long)sizeof(out)) return false;
+    std::memcpy(&out, p, sizeof(out));
+    p += sizeof(out);
+    return true;
+  }
+  /**
+   * A function to read a string from a buffer.
+   * @param p The current position, advanced past the string
+   * @param end The end of the buffer
+   * @param out The string read
+   * @returns True if the string was read, false if the buffer is too short
+   */
+  inline bool read_string(const char*& p, const char* end, std::string& out) {
+    uint32_t length;
+    if (!read_u32(p, end, length) || end - p < (long)length) return false;
+    out.assign(p, length);
+    p += length;
+    return true;
+  }
+
+  /**
+   * A function to encode the users and tasks of a version.
+   * The types are the caller's own, so tasky encodes its lists without copying them.
+   * @param users A list of users, each with a username and password
+   * @param tasks A list of tasks, each with the fields of the layout
+   * @returns The encoded data
+   */
+  template <class Users, class Tasks>
+  std::string encode(const Users& users, const Tasks& tasks) {
+    std::string out;
+    write_u32(out, users.size());
+    for (size_t i = 0; i < users.size(); i++) {
+      write_string(out, users[i].username);
+      write_string(out, users[i].password);
+    }
+    write_u32(out, tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+      const auto& task = tasks[i];
+      write_string(out, task.username);
+      write_string(out, task.title);
+      write_string(out, task.description);
+      write_u32(out, (uint32_t)(int32_t)task.status);
+      write_u32(out, (uint32_t)(int32_t)task.priority);
+      write_string(out, task.due_date);
+      write_string(out, task.start_date);
+      write_u32(out, task.tags.size());
+      for (size_t j = 0; j < task.tags.size(); j++) write_string(out, task.tags[j]);
+    }
+    return out;
+  }
+  /**
+   * A function to decode the users of a version.
+   * @param p The current position, at the start of the data, advanced past the users
+   * @param end The end of the data
+   * @param users The list to add the users to, of a type with a username and password
+   * @returns True if the users were read, false if the data is too short
+   */
+  template <class User>
+  bool decode_users(const char*& p, const char* end, std::vector<User>& users) {
+    uint32_t count;
+    if (!read_u32(p, end, count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      User user;
+      if (!read_string(p, end, user.username) || !read_string(p, end, user.password)) return false;
+      users.push_back(std::move(user));
+    }
+    return true;
+  }
+  /**
+   * A function to decode the tasks of a version.
+   * @param p The current position, after the users, advanced past the tasks
+   * @param end The end of the data
+   * @param tasks The list to add the tasks to, of a type with the fields of the layout
+   * @returns True if the tasks were read, false if the data is too short
+   */
+  template <class Task>
+  bool decode_tasks(const char*& p, const char* end, std::vector<Task>& tasks) {
+    uint32_t count;
+    if (!read_u32(p, end, count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      Task task;
+      uint32_t status, priority, tag_count;
+      if (!read_string(p, end, task.username) || !read_string(p, end, task.title) || !read_string(p, end, task.description)) return false;
+      if (!read_u32(p, end, status) || !read_u32(p, end, priority)) return false;
+      if (!read_string(p, end, task.due_date) || !read_string(p, end, task.start_date) || !read_u32(p, end, tag_count)) return false;
+      task.status = (decltype(task.status))(int32_t)status;
+      task.priority = (decltype(task.priority))(int32_t)priority;
+      for (uint32_t j = 0; j < tag_count; j++) {
+        std::string tag;
+        if (!read_string(p, end, tag)) return false;
+        task.tags.push_back(std::move(tag));
+      }
+      tasks.push_back(std::move(task));
+    }
+    return true;
+  }
+  /**
+   * A function to decode a whole version.
+   * @param data The encoded users and tasks
+   * @param users The list to add the users to
+   * @param tasks The list to add the tasks to
+   * @returns True if the whole version was read, false if it is too short or has bytes left over
+   */
+  template <class User, class Task>
+  bool decode(const std::string& data, std::vector<User>& users, std::vector<Task>& tasks) {
+    const char* p = data.data();
+    const char* end = p + data.size();
+    return decode_users(p, end, users) && decode_tasks(p, end, tasks) && p == end;
+  }
+
+  /**
+   * A class to publish versions of the data to a region.
+   * Only one writer may use a region at a time, which open enforces with a lock on the region.
+   */
+  class Writer {
+    private:
+    int fd = -1; /**< The shared memory object */
+    char* base = nullptr; /**< The mapping of the region */
+    size_t mapped = 0; /**< The length of the mapping */
+
+    /**
+     * A function to resize the region and map all of it.
+     * @param length The length of the region, including the header
+     * @returns True if the region was mapped, false otherwise
+     */
+    bool map(size_t length) {
+      if (ftruncate(fd, length) != 0) return false;
+      if (base) munmap(base, mapped);
+      void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      base = address == MAP_FAILED ? nullptr : (char*)address;
+      mapped = base ? length : 0;
+      return base != nullptr;
+    }
+    Header* header() {
+      return (Header*)base;
+    }
+
+    public:
+    Writer() {}
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    ~Writer() {
+      if (base) munmap(base, mapped);
+      if (fd >= 0) close(fd);
+    }
+
+    /**
+     * A function to release the region after open has failed part way.
+     * @returns False, so open can return the result directly
+     */
+    bool fail() {
+      if (base) munmap(base, mapped);
+      if (fd >= 0) close(fd);
+      base = nullptr;
+      mapped = 0;
+      fd = -1;
+      return false;
+    }
+
+    /**
+     * A function to open a region, creating it if it does not exist.
+     * A region left by an earlier writer is reused, and its readers keep working. If that writer stopped part way
+     * through copying a version in, the sequence number is left odd, so it is rounded up to even with an empty
+     * version; otherwise readers would retry until they gave up, and every later version would look odd to them.
+     * @param name The name of the region, starting with a slash
+     * @returns True if the region was opened, false if it could not be, or another writer has it open
+     */
+    bool open(const std::string& name) {
+      fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+      if (fd < 0) return false;
+      if (flock(fd, LOCK_EX | LOCK_NB) != 0) return fail();
+      struct stat status;
+      if (fstat(fd, &status) != 0) return fail();
+      bool is_new = status.st_size < (off_t)sizeof(Header);
+      if (!map(is_new ? sizeof(Header) + 4096 : status.st_size)) return fail();
+      if (is_new || header()->magic != MAGIC) {
+        header()->sequence.store(0, std::memory_order_relaxed);
+        header()->size.store(0, std::memory_order_relaxed);
+        header()->capacity.store(mapped - sizeof(Header), std::memory_order_relaxed);
+        header()->magic = MAGIC;
+      }
+      uint64_t sequence = header()->sequence.load(std::memory_order_relaxed);
+      if (sequence & 1) {
+        header()->size.store(0, std::memory_order_relaxed);
+        header()->sequence.store(sequence + 1, std::memory_order_release);
+      }
+      return true;
+    }
+
+    /**
+     * A function to publish a new version of the data.
+     * The region grows first if the data does not fit, and readers remap it when they see the new size.
+     * @param data The encoded users and tasks
+     * @returns True if the version was published, false if the region could not grow
+     */
+    bool publish(const std::string& data) {
+      if (!base) return false;
+      uint64_t capacity = header()->capacity.load(std::memory_order_relaxed);
+      if (data.size() > capacity) {
+        capacity = std::max<uint64_t>(data.size(), capacity * 2);
+        if (!map(sizeof(Header) + capacity)) return false;
+        header()->capacity.store(capacity, std::memory_order_release);
+      }
+
+      uint64_t sequence = header()->sequence.load(std::memory_order_relaxed);
+      header()->sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      std::memcpy(base + sizeof(Header), data.data(), data.size());
+      header()->size.store(data.size(), std::memory_order_relaxed);
+      header()->sequence.store(sequence + 2, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * A function to remove a region, so new readers cannot open it.
+     * Readers and writers that already have it open keep their mappings.
+     * @param name The name of the region
+     */
+    static void remove(const std::string& name) {
+      shm_unlink(name.c_str());
+    }
+  };
+
+  /**
+   * A class to read versions of the data from a region.
+   */
+  class Reader {
+    private:
+    int fd = -1; /**< The shared memory object */
+    const char* base = nullptr; /**< The mapping of the region */
+    size_t mapped = 0; /**< The length of the mapping */
+
+    /**
+     * A function to map the whole region again, after the writer has grown it.
+     * @returns True if the region was mapped, false otherwise
+     */
+    bool map() {
+      struct stat status;
+      if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(Header)) return false;
+      if (base) munmap((void*)base, mapped);
+      void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      base = address == MAP_FAILED ? nullptr : (const char*)address;
+      mapped = base ? status.st_size : 0;
+      return base != nullptr;
+    }
+    const Header* header() const {
+      return (const Header*)base;
+    }
+
+    public:
+    Reader() {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() {
+      if (base) munmap((void*)base, mapped);
+      if (fd >= 0) close(fd);
+    }
+
+    /**
+     * A function to open a region published by a writer.
+     * @param name The name of the region, starting with a slash
+     * @returns True if the region exists and has been set up by a writer, false otherwise
+     */
+    bool open(const std::string& name) {
+      fd = shm_open(name.c_str(), O_RDONLY, 0);
+      return fd >= 0 && map() && header()->magic == MAGIC;
+    }
+
+    /**
+     * A function to get the number of the current version, which is cheap enough to poll for changes.
+     * @returns The number of versions published so far
+     */
+    uint64_t version() const {
+      return header()->sequence.load(std::memory_order_acquire) / 2;
+    }
+
+    /**
+     * A function to copy out the current version of the data.
+     * The function retries while the writer is copying a version in, and gives up after a number of attempts.
+     * @param data The encoded users and tasks
+     * @param version The number of the version copied
+     * @returns True if a whole version was copied, false otherwise
+     */
+    bool read(std::string& data, uint64_t& version) {
+      for (int attempt = 0; attempt < 10000; attempt++) {
+        uint64_t before = header()->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+          std::this_thread::yield();
+          continue;
+        }
+        uint64_t size = header()->size.load(std::memory_order_relaxed);
+        if (sizeof(Header) + size > mapped) {
+          if (!map()) return false;
+          continue;
+        }
+        data.assign(base + sizeof(Header), size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header()->sequence.load(std::memory_order_relaxed) == before) {
+          version = before / 2;
+          return true;
+        }
+      }
+      return false;
+    }
+  };
+}
+
+#endif
@@ -3,7 +3,25 @@
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <experimental/filesystem>
+#include "metrics.h"
+#include "shared.h"
 
 using namespace std::experimental::filesystem;
 using std::to_string;
@@ -78,6 +96,9 @@ struct Task {
   string start_date; /**< The start date of the task */
 
   vector<string> tags; /**< The tags of the task */
+
+  long body_offset = -1; /**< The position of the task in the data file if its description and tags are not loaded yet, or -1 */
+  int body_length = 0; /**< The length of the task in the data file */
 };
 /**
  * A function to convert a vector of tags to a string.
@@ -99,15 +120,9 @@ string to_string(vector<string> tags) {
 namespace Helper {
   /**
    * A class to provide helper functions for tasks.
-   * This class provides functions to check if a date is valid and to sort tasks by date.
+   * This class provides functions to check if a date is valid and to do arithmetic on dates.
    * The date format is "YYYY-MM-DD".
-   * The sorting algorithm used is bubble sort.
-   * The sorting function is passed as a callback.
-   * The sorting function should take a vector of tasks and a boolean reference as arguments.
-   * The boolean reference is used to check if any swaps were made during the sorting process.
-   * The sorting function should swap tasks if the first task is greater than the second task.
-   * The sorting function should set the boolean reference to true if any swaps were made.
-   * The sorting function should return void.
+   * Tasks are ordered by date through the date indexes, see Index::DateIndex.
    */
   class Date {
     public:
@@ -141,17 +156,128 @@ namespace Helper {
         normalizedTime->tm_mday == timeStruct.tm_mday;
     }
     /**
-     * A function to sort tasks by date. Uses the bubble sort algorithm
-     * @param arr The array of tasks to sort
-     * @param sort The sorting function to use
+     * A function to check if a date is valid without going through the C time functions.
+     * The date must be exactly "YYYY-MM-DD", so it also sorts correctly as a string.
+     * @param date The date to check
+     * @returns True if the date is valid, false otherwise
+     */
+    static bool is_date_valid_fast(const string& date) {
+      if (date.size() != 10 || date[4] != '-' || date[7] != '-') return false;
+      for (int i = 0; i < 10; i++) {
+        if (i != 4 && i != 7 && (date[i] < '0' || date[i] > '9')) return false;
+      }
+
+      int year = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+      int month = (date[5] - '0') * 10 + (date[6] - '0');
+      int day = (date[8] - '0') * 10 + (date[9] - '0');
+      if (month < 1 || month > 12 || day < 1) return false;
+
+      static const int days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+      bool is_leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+      return day <= days_in_month[month - 1] + (month == 2 && is_leap ? 1 : 0);
+    }
+    /**
+     * A function to check the dates of a batch of tasks.
+     * Consecutive tasks often share dates, so the result for the previous date is reused.
+     * @param tasks The tasks to check
+     * @param valid The result for each task, true if both its due date and start date are valid
+     * @returns The number of tasks with invalid dates
      */
-    static void sort_date(vector<Task> &arr, void (*sort_condition)(vector<Task>&, bool &swapped, int &j)) {
-      bool swapped = false;
-      for (int i = 0; i < arr.size() - 1; i++) {
-        for (int j = 0; j < arr.size() - i - 1; j++) 
-          sort_condition(arr, swapped, j); // Call the sorting function condition as a callback
-        if (!swapped) break; // If no swaps were made, the array is sorted
+    static int validate_dates(const vector<Task>& tasks, vector<bool>& valid) {
+      valid.assign(tasks.size(), false);
+      string last_date;
+      bool last_valid = false;
+      int invalid = 0;
+
+      for (int i = 0; i < tasks.size(); i++) {
+        bool is_valid = true;
+        const string* dates[] = { &tasks[i].due_date, &tasks[i].start_date };
+        for (int j = 0; j < 2; j++) {
+          if (*dates[j] != last_date) {
+            last_date = *dates[j];
+            last_valid = is_date_valid_fast(last_date);
+          }
+          is_valid = is_valid && last_valid;
+        }
+        valid[i] = is_valid;
+        if (!is_valid) invalid++;
       }
+      return invalid;
+    }
+    /**
+     * A function to get the current date.
+     * @returns The current date in the format "YYYY-MM-DD"
+     */
+    static string today() {
+      std::time_t time = std::time(nullptr);
+      char buffer[11];
+      std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", std::localtime(&time));
+      return buffer;
+    }
+    /**
+     * A function to add a number of days to a date.
+     * @param date The date to add the days to, in the format "YYYY-MM-DD"
+     * @param days The number of days to add, may be negative
+     * @returns The resulting date in the format "YYYY-MM-DD"
+     */
+    static string add_days(const string& date, int days) {
+      tm timeStruct = {};
+      std::istringstream iss(date);
+      iss >> std::get_time(&timeStruct, "%Y-%m-%d");
+      if (iss.fail()) return date;
+
+      // Let mktime carry the overflowing day into the month and year
+      timeStruct.tm_mday += days;
+      timeStruct.tm_isdst = -1;
+      std::mktime(&timeStruct);
+
+      char buffer[11];
+      std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", &timeStruct);
+      return buffer;
+    }
+    /**
+     * A function to convert a date to the number of days since 1970-01-01.
+     * @param date The date to convert, which must be exactly "YYYY-MM-DD"
+     * @param days The number of days, which is negative for dates before 1970
+     * @returns True if the date is valid, false otherwise
+     */
+    static bool to_days(const string& date, long& days) {
+      if (!is_date_valid_fast(date)) return false;
+      long year = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+      long month = (date[5] - '0') * 10 + (date[6] - '0');
+      long day = (date[8] - '0') * 10 + (date[9] - '0');
+
+      // Count from March, so the leap day is the last day of the year; January and February of year 0 fall in year -1
+      if (month <= 2) year--;
+      long era = (year >= 0 ? year : year - 399) / 400;
+      long year_of_era = year - era * 400;
+      long day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+      long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+      days = era * 146097 + day_of_era - 719468;
+      return true;
+    }
+    /**
+     * A function to convert a number of days since 1970-01-01 to a date.
+     * @param days The number of days, for a date from year 0 to 9999
+     * @returns The date in the format "YYYY-MM-DD"
+     */
+    static string from_days(long days) {
+      days += 719468;
+      long era = (days >= 0 ? days : days - 146096) / 146097;
+      long day_of_era = days - era * 146097;
+      long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+      long day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+      long shifted_month = (5 * day_of_year + 2) / 153;
+      long day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+      long month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+      long year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+      char buffer[11] = {
+        (char)('0' + year / 1000), (char)('0' + year / 100 % 10), (char)('0' + year / 10 % 10), (char)('0' + year % 10), '-',
+        (char)('0' + month / 10), (char)('0' + month % 10), '-',
+        (char)('0' + day / 10), (char)('0' + day % 10), '\0'
+      };
+      return buffer;
     }
   };
 
@@ -231,242 +357,2330 @@ namespace Helper {
       vector<string> tag_list = split(tags, ','); // Split the tags by comma
       return tag_list;
     }
-  };
-}
+  };
+
+  /**
+   * A class to provide functions for reading and writing tasks and users as flat json objects.
+   * This class is used where the json library is too slow or cannot be used, such as bulk imports of millions of tasks
+   * and loading tasks without their descriptions and tags.
+   * The functions work directly on character buffers and do not allocate json objects.
+   * The reading functions advance the position they are given and return false if the input is malformed.
+   * Keys that are not fields of a task are skipped.
+   */
+  class Json {
+    private:
+    /**
+     * A function to append a unicode code point to a string as UTF-8.
+     * @param out The string to append to
+     * @param code The code point to append
+     */
+    static void append_utf8(string& out, unsigned code) {
+      if (code < 0x80) out += (char)code;
+      else if (code < 0x800) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+      }
+      else {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+      }
+    }
+
+    public:
+    /**
+     * A function to skip whitespace.
+     * @param p The current position, advanced past the whitespace
+     * @param end The end of the buffer
+     */
+    static void skip_space(const char*& p, const char* end) {
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+    /**
+     * A function to read a json string.
+     * @param p The current position, which must be at the opening quote
+     * @param end The end of the buffer
+     * @param out The string read, with escapes decoded
+     * @returns True if a string was read, false otherwise
+     */
+    static bool read_string(const char*& p, const char* end, string& out) {
+      if (p >= end || *p != '"') return false;
+      p++;
+      out.clear();
+      while (p < end) {
+        // Copy the run of plain characters in one go
+        const char* start = p;
+        while (p < end && *p != '"' && *p != '\\') p++;
+        out.append(start, p - start);
+        if (p >= end) return false;
+        if (*p == '"') {
+          p++;
+          return true;
+        }
+
+        // Decode the escape sequence
+        if (++p >= end) return false;
+        switch (*p++) {
+          case '"': out += '"'; break;
+          case '\\': out += '\\'; break;
+          case '/': out += '/'; break;
+          case 'b': out += '\b'; break;
+          case 'f': out += '\f'; break;
+          case 'n': out += '\n'; break;
+          case 'r': out += '\r'; break;
+          case 't': out += '\t'; break;
+          case 'u': {
+            if (end - p < 4) return false;
+            unsigned code = 0;
+            for (int i = 0; i < 4; i++, p++) {
+              char c = *p;
+              code <<= 4;
+              if (c >= '0' && c <= '9') code |= c - '0';
+              else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+              else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+              else return false;
+            }
+            append_utf8(out, code);
+            break;
+          }
+          default: return false;
+        }
+      }
+      return false;
+    }
+    /**
+     * A function to read a json integer.
+     * A fractional part or exponent, as written by some json libraries for whole numbers, is skipped.
+     * @param p The current position, advanced past the number
+     * @param end The end of the buffer
+     * @param out The number read
+     * @returns True if a number was read, false otherwise
+     */
+    static bool read_integer(const char*& p, const char* end, int& out) {
+      bool negative = p < end && *p == '-';
+      if (negative) p++;
+      if (p >= end || *p < '0' || *p > '9') return false;
+      out = 0;
+      while (p < end && *p >= '0' && *p <= '9') out = out * 10 + (*p++ - '0');
+      while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) p++;
+      if (negative) out = -out;
+      return true;
+    }
+    /**
+     * A function to read a json array of strings.
+     * @param p The current position, which must be at the opening bracket
+     * @param end The end of the buffer
+     * @param out The strings read
+     * @returns True if an array was read, false otherwise
+     */
+    static bool read_string_array(const char*& p, const char* end, vector<string>& out) {
+      if (p >= end || *p != '[') return false;
+      p++;
+      out.clear();
+      skip_space(p, end);
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      while (p < end) {
+        string value;
+        skip_space(p, end);
+        if (!read_string(p, end, value)) return false;
+        out.push_back(value);
+        skip_space(p, end);
+        if (p < end && *p == ',') p++;
+        else if (p < end && *p == ']') {
+          p++;
+          return true;
+        }
+        else return false;
+      }
+      return false;
+    }
+    /**
+     * A function to skip a json value of any type.
+     * @param p The current position, advanced past the value
+     * @param end The end of the buffer
+     * @returns True if a value was skipped, false otherwise
+     */
+    static bool skip_value(const char*& p, const char* end) {
+      if (p >= end) return false;
+      if (*p == '"') {
+        string ignored;
+        return read_string(p, end, ignored);
+      }
+      if (*p == '{' || *p == '[') {
+        // Skip to the matching bracket, stepping over strings
+        int depth = 0;
+        while (p < end) {
+          if (*p == '"') {
+            string ignored;
+            if (!read_string(p, end, ignored)) return false;
+            continue;
+          }
+          if (*p == '{' || *p == '[') depth++;
+          if (*p == '}' || *p == ']') depth--;
+          p++;
+          if (depth == 0) return true;
+        }
+        return false;
+      }
+      // Numbers, true, false and null
+      const char* start = p;
+      while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') p++;
+      return p > start;
+    }
+    /**
+     * A function to read the fields of a json object.
+     * @param p The current position, which may be before the opening brace, advanced past the closing brace
+     * @param end The end of the buffer
+     * @param read_field The function to read the value of each field, given its key; it must skip fields it does not use
+     * @returns True if the object was read, false if it or one of its fields is malformed
+     */
+    static bool read_object(const char*& p, const char* end, const std::function<bool(const string& key, const char*& p, const char* end)>& read_field) {
+      skip_space(p, end);
+      if (p >= end || *p != '{') return false;
+      p++;
+      skip_space(p, end);
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+
+      string key;
+      while (p < end) {
+        skip_space(p, end);
+        if (!read_string(p, end, key)) return false;
+        skip_space(p, end);
+        if (p >= end || *p != ':') return false;
+        p++;
+        skip_space(p, end);
+        if (!read_field(key, p, end)) return false;
+
+        skip_space(p, end);
+        if (p < end && *p == ',') p++;
+        else if (p < end && *p == '}') {
+          p++;
+          return true;
+        }
+        else return false;
+      }
+      return false;
+    }
+    /**
+     * A function to read a user from a json object.
+     * @param p The current position, which may be before the opening brace, advanced past the closing brace
+     * @param end The end of the buffer
+     * @param user The user read
+     * @returns True if a user was read, false otherwise
+     */
+    static bool read_user(const char*& p, const char* end, User& user) {
+      user = User{"", ""};
+      skip_space(p, end);
+      if (p >= end || *p != '{') return false;
+      p++;
+      skip_space(p, end);
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+
+      string key;
+      while (p < end) {
+        skip_space(p, end);
+        if (!read_string(p, end, key)) return false;
+        skip_space(p, end);
+        if (p >= end || *p != ':') return false;
+        p++;
+        skip_space(p, end);
+
+        bool ok;
+        if (key == "username") ok = read_string(p, end, user.username);
+        else if (key == "password") ok = read_string(p, end, user.password);
+        else ok = skip_value(p, end);
+        if (!ok) return false;
+
+        skip_space(p, end);
+        if (p < end && *p == ',') p++;
+        else if (p < end && *p == '}') {
+          p++;
+          return true;
+        }
+        else return false;
+      }
+      return false;
+    }
+    /**
+     * A function to read a task from a json object.
+     * Missing fields are left empty, with no status and no priority.
+     * @param p The current position, which may be before the opening brace, advanced past the closing brace
+     * @param end The end of the buffer
+     * @param task The task read
+     * @param headers_only Whether to skip the description and tags, which are not needed to list and sort tasks
+     * @returns True if a task was read, false otherwise
+     */
+    static bool read_task(const char*& p, const char* end, Task& task, bool headers_only = false) {
+      task = Task{"", "", "", NO_STATUS, NO_PRIORITY, "", "", {}};
+      skip_space(p, end);
+      if (p >= end || *p != '{') return false;
+      p++;
+      skip_space(p, end);
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+
+      string key;
+      while (p < end) {
+        skip_space(p, end);
+        if (!read_string(p, end, key)) return false;
+        skip_space(p, end);
+        if (p >= end || *p != ':') return false;
+        p++;
+        skip_space(p, end);
+
+        bool ok;
+        int number = 0;
+        if (key == "username") ok = read_string(p, end, task.username);
+        else if (key == "title") ok = read_string(p, end, task.title);
+        else if (headers_only && (key == "description" || key == "tags")) ok = skip_value(p, end);
+        else if (key == "description") ok = read_string(p, end, task.description);
+        else if (key == "due_date") ok = read_string(p, end, task.due_date);
+        else if (key == "start_date") ok = read_string(p, end, task.start_date);
+        else if (key == "tags") ok = read_string_array(p, end, task.tags);
+        else if (key == "status") {
+          ok = read_integer(p, end, number);
+          task.status = (TaskStatus)number;
+        }
+        else if (key == "priority") {
+          ok = read_integer(p, end, number);
+          task.priority = (Priority)number;
+        }
+        else ok = skip_value(p, end);
+        if (!ok) return false;
+
+        skip_space(p, end);
+        if (p < end && *p == ',') p++;
+        else if (p < end && *p == '}') {
+          p++;
+          return true;
+        }
+        else return false;
+      }
+      return false;
+    }
+    /**
+     * A function to append a json string to a buffer, escaping it as needed.
+     * @param out The buffer to append to
+     * @param value The string to append
+     */
+    static void write_string(string& out, const string& value) {
+      out += '"';
+      for (int i = 0; i < value.size(); i++) {
+        unsigned char c = value[i];
+        switch (c) {
+          case '"': out += "\\\""; break;
+          case '\\': out += "\\\\"; break;
+          case '\n': out += "\\n"; break;
+          case '\r': out += "\\r"; break;
+          case '\t': out += "\\t"; break;
+          default:
+            if (c < 0x20) {
+              char escape[7];
+              std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+              out += escape;
+            }
+            else out += (char)c;
+        }
+      }
+      out += '"';
+    }
+    /**
+     * A function to append a task to a buffer as a single line json object.
+     * @param out The buffer to append to
+     * @param task The task to append
+     */
+    static void write_task(string& out, const Task& task) {
+      out += "{\"username\":";
+      write_string(out, task.username);
+      out += ",\"title\":";
+      write_string(out, task.title);
+      out += ",\"description\":";
+      write_string(out, task.description);
+      out += ",\"status\":" + to_string((int)task.status);
+      out += ",\"priority\":" + to_string((int)task.priority);
+      out += ",\"due_date\":";
+      write_string(out, task.due_date);
+      out += ",\"start_date\":";
+      write_string(out, task.start_date);
+      out += ",\"tags\":[";
+      for (int i = 0; i < task.tags.size(); i++) {
+        if (i > 0) out += ',';
+        write_string(out, task.tags[i]);
+      }
+      out += "]}";
+    }
+  };
+
+  /**
+   * A class to provide functions for reading and writing tasks in a compact binary format.
+   * A block of tasks is stored column by column, so each column holds similar values:
+   * - Usernames, tags and the words of titles and descriptions are replaced by their position in a dictionary.
+   *   The dictionary is ordered by frequency, so the most common strings take one byte.
+   *   Words that are numbers are stored as numbers instead.
+   * - Dates are stored as the difference in days from the previous date, so nearby dates take one byte.
+   *   Dates that are not exactly "YYYY-MM-DD" are stored as they are.
+   * - Status and priority are packed into three bits each, in one byte per task. A task with a value outside 0 to 7
+   *   has the byte 0x80 instead, and both values follow the bytes as zigzag varints, so every value reads back as it was.
+   * Integers are stored as varints, seven bits per byte with the high bit set on every byte but the last.
+   * The functions work directly on character buffers, like Json, and the reading functions return false if the input is malformed.
+   */
+  class Packed {
+    private:
+    static const unsigned char WIDE = 0x80; /**< The status and priority byte of a task whose values do not fit in three bits */
+
+    /**
+     * A function to append an unsigned integer as a varint.
+     * @param out The string to append to
+     * @param value The integer to append
+     */
+    static void write_varint(string& out, uint64_t value) {
+      while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+      }
+      out += (char)value;
+    }
+    /**
+     * A function to read a varint.
+     * @param p The current position, advanced past the varint
+     * @param end The end of the buffer
+     * @param out The integer read
+     * @returns True if the varint was read, false otherwise
+     */
+    static bool read_varint(const char*& p, const char* end, uint64_t& out) {
+      out = 0;
+      for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        out |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) return true;
+      }
+      return false;
+    }
+    /**
+     * A function to map a signed integer to an unsigned one, so small negative numbers take few varint bytes.
+     * @param value The integer
+     * @returns 2 * value for a value that is not negative, and -2 * value - 1 for a negative value
+     */
+    static uint64_t zigzag(long value) {
+      return value < 0 ? ~((uint64_t)value << 1) : (uint64_t)value << 1;
+    }
+    /**
+     * A function to reverse zigzag.
+     * @param value The mapped integer
+     * @returns The signed integer
+     */
+    static long unzigzag(uint64_t value) {
+      return (value & 1) ? ~(long)(value >> 1) : (long)(value >> 1);
+    }
+    /**
+     * A function to append a string as its length followed by its bytes.
+     * @param out The string to append to
+     * @param value The string to append
+     */
+    static void write_bytes(string& out, const string& value) {
+      write_varint(out, value.size());
+      out += value;
+    }
+    /**
+     * A function to read a string stored as its length followed by its bytes.
+     * @param p The current position, advanced past the string
+     * @param end The end of the buffer
+     * @param out The string read
+     * @returns True if the string was read, false otherwise
+     */
+    static bool read_bytes(const char*& p, const char* end, string& out) {
+      uint64_t length;
+      if (!read_varint(p, end, length) || length > (uint64_t)(end - p)) return false;
+      out.assign(p, length);
+      p += length;
+      return true;
+    }
+    /**
+     * A function to check if a word is a number that is written the same way by to_string.
+     * @param word The word to check
+     * @param number The number, if the word is one
+     * @returns True if the word is a number below 10^9 with no leading zeros, false otherwise
+     */
+    static bool to_number(std::string_view word, uint32_t& number) {
+      if (word.empty() || word.size() > 9 || (word[0] == '0' && word.size() > 1)) return false;
+      number = 0;
+      for (size_t i = 0; i < word.size(); i++) {
+        if (word[i] < '0' || word[i] > '9') return false;
+        number = number * 10 + (word[i] - '0');
+      }
+      return true;
+    }
+    /**
+     * A struct representing the strings of a block of tasks that go through the dictionary, in the order they are first seen.
+     * The positions are kept in an open addressing table, since every word of every task is looked up.
+     * The strings are views into the tasks, so the tasks must outlive the dictionary.
+     */
+    struct Dictionary {
+      vector<uint32_t> slots = vector<uint32_t>(1024, 0); /**< The position of each string plus one, or 0 for an empty slot */
+      vector<std::string_view> strings; /**< The strings, by position */
+      vector<uint64_t> frequency; /**< The number of times each string is used, by position */
+
+      /**
+       * A function to hash a string with FNV-1a.
+       * @param value The string
+       * @returns The hash of the string
+       */
+      static uint32_t hash(std::string_view value) {
+        uint32_t result = 2166136261u;
+        for (size_t i = 0; i < value.size(); i++) {
+          result ^= (unsigned char)value[i];
+          result *= 16777619u;
+        }
+        return result;
+      }
+      /**
+       * A function to get the position of a string, adding it if it is new.
+       * @param value The string
+       * @returns The position of the string
+       */
+      uint32_t add(std::string_view value) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(value) & mask;; i = (i + 1) & mask) {
+          if (slots[i] == 0) break;
+          if (strings[slots[i] - 1] == value) {
+            frequency[slots[i] - 1]++;
+            return slots[i] - 1;
+          }
+        }
+
+        strings.push_back(value);
+        frequency.push_back(1);
+        size_t first = strings.size() - 1;
+        if (strings.size() * 2 > slots.size()) {
+          slots.assign(slots.size() * 2, 0);
+          first = 0;
+        }
+
+        // Place the new string, or every string if the table grew
+        mask = slots.size() - 1;
+        for (size_t id = first; id < strings.size(); id++) {
+          size_t i = hash(strings[id]) & mask;
+          while (slots[i] != 0) i = (i + 1) & mask;
+          slots[i] = id + 1;
+        }
+        return strings.size() - 1;
+      }
+      /**
+       * A function to add the words of a string, separated by single spaces.
+       * Joining the words with single spaces gives back the string, including repeated and trailing spaces.
+       * Each word is stored shifted left by one, with the lowest bit set for a number and clear for a position,
+       * so numbered titles such as "Task 1234" do not fill the dictionary.
+       * @param text The string
+       * @param stream The stream to append the number of words and then their positions to
+       */
+      void add_words(const string& text, vector<uint32_t>& stream) {
+        size_t count = stream.size();
+        stream.push_back(0);
+        if (text.empty()) return;
+        size_t start = 0;
+        for (size_t i = 0; i <= text.size(); i++) {
+          if (i == text.size() || text[i] == ' ') {
+            std::string_view word(text.data() + start, i - start);
+            uint32_t number;
+            if (to_number(word, number)) stream.push_back(number << 1 | 1);
+            else stream.push_back(add(word) << 1);
+            start = i + 1;
+          }
+        }
+        stream[count] = stream.size() - count - 1;
+      }
+    };
+    /**
+     * A function to append a date as the difference from the previous date.
+     * The lowest bit of the varint is 0 for a zigzag encoded difference, and 1 for a date stored as it is.
+     * @param out The string to append to
+     * @param date The date to append
+     * @param previous The previous date in days, updated to this date if it is valid
+     */
+    static void write_date(string& out, const string& date, long& previous) {
+      long days;
+      if (!Date::to_days(date, days)) {
+        write_varint(out, 1);
+        write_bytes(out, date);
+        return;
+      }
+      long delta = days - previous;
+      previous = days;
+      write_varint(out, zigzag(delta) << 1);
+    }
+    typedef vector<std::pair<long, string>> DateCache; /**< Recently read dates and their days, in the slot given by the low bits of the days */
+    /**
+     * A function to read a date stored as the difference from the previous date.
+     * The dates read are kept in a cache, since start and due dates alternate and most tasks fall within a few years,
+     * so each date is only formatted once.
+     * @param p The current position, advanced past the date
+     * @param end The end of the buffer
+     * @param out The date read
+     * @param previous The previous date in days, updated to this date if it was stored as a difference
+     * @param cache The dates read as a difference, which must have a power of two size
+     * @returns True if the date was read, false otherwise
+     */
+    static bool read_date(const char*& p, const char* end, string& out, long& previous, DateCache& cache) {
+      uint64_t value;
+      if (!read_varint(p, end, value)) return false;
+      if (value & 1) return read_bytes(p, end, out);
+      previous += unzigzag(value >> 1);
+      std::pair<long, string>& slot = cache[(unsigned long)previous & (cache.size() - 1)];
+      if (slot.second.empty() || slot.first != previous) slot = { previous, Date::from_days(previous) };
+      out = slot.second;
+      return true;
+    }
+    /**
+     * A function to get the number of decimal digits of a number.
+     * @param number The number
+     * @returns The number of digits, at least 1
+     */
+    static size_t digits(uint64_t number) {
+      size_t result = 1;
+      while (number >= 10) {
+        number /= 10;
+        result++;
+      }
+      return result;
+    }
+    /**
+     * A function to read a string stored as its words, each a number or a position in the dictionary.
+     * The words are read twice, first to find the length and then to copy them, so the string is allocated once
+     * rather than growing word by word.
+     * @param p The current position, advanced past the string
+     * @param end The end of the buffer
+     * @param dictionary The dictionary
+     * @param out The string read
+     * @returns True if the string was read, false otherwise
+     */
+    static bool read_text(const char*& p, const char* end, const vector<string>& dictionary, string& out) {
+      uint64_t count, word;
+      if (!read_varint(p, end, count)) return false;
+      const char* words = p;
+      size_t length = 0;
+      for (uint64_t i = 0; i < count; i++) {
+        if (!read_varint(p, end, word)) return false;
+        if (word & 1) length += digits(word >> 1);
+        else if ((word >> 1) < dictionary.size()) length += dictionary[word >> 1].size();
+        else return false;
+        if (i > 0) length++;
+      }
+
+      out.resize(length);
+      char* q = &out[0];
+      for (uint64_t i = 0; i < count; i++) {
+        read_varint(words, end, word);
+        if (i > 0) *q++ = ' ';
+        if (word & 1) {
+          size_t size = digits(word >> 1);
+          word >>= 1;
+          for (size_t j = size; j > 0; j--, word /= 10) q[j - 1] = '0' + word % 10;
+          q += size;
+          continue;
+        }
+        const string& value = dictionary[word >> 1];
+        std::memcpy(q, value.data(), value.size());
+        q += value.size();
+      }
+      return true;
+    }
+
+    public:
+    /**
+     * A function to append a block of tasks.
+     * @param out The string to append to
+     * @param tasks The tasks to append
+     */
+    static void write_tasks(string& out, const vector<const Task*>& tasks) {
+      // Replace every string that goes through the dictionary with its position
+      Dictionary dictionary;
+      vector<uint32_t> usernames, stream;
+      usernames.reserve(tasks.size());
+      for (int i = 0; i < tasks.size(); i++)
+        usernames.push_back(dictionary.add(tasks[i]->username));
+      for (int i = 0; i < tasks.size(); i++)
+        dictionary.add_words(tasks[i]->title, stream);
+      for (int i = 0; i < tasks.size(); i++)
+        dictionary.add_words(tasks[i]->description, stream);
+      for (int i = 0; i < tasks.size(); i++) {
+        stream.push_back(tasks[i]->tags.size());
+        for (int j = 0; j < tasks[i]->tags.size(); j++) stream.push_back(dictionary.add(tasks[i]->tags[j]) << 1);
+      }
+
+      // Give the most frequent strings the smallest ids
+      vector<uint32_t> order(dictionary.strings.size());
+      for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+      std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (dictionary.frequency[a] != dictionary.frequency[b]) return dictionary.frequency[a] > dictionary.frequency[b];
+        return dictionary.strings[a] < dictionary.strings[b];
+      });
+      vector<uint32_t> ids(order.size());
+      out += "TSKP";
+      write_varint(out, tasks.size());
+      write_varint(out, order.size());
+      for (uint32_t i = 0; i < order.size(); i++) {
+        ids[order[i]] = i;
+        write_varint(out, dictionary.strings[order[i]].size());
+        out += dictionary.strings[order[i]];
+      }
+
+      // Write the columns
+      for (int i = 0; i < tasks.size(); i++) write_varint(out, ids[usernames[i]]);
+      auto fits = [](int value) { return value >= 0 && value < 8; };
+      for (int i = 0; i < tasks.size(); i++) {
+        int status = tasks[i]->status, priority = tasks[i]->priority;
+        out += (char)(fits(status) && fits(priority) ? status | priority << 3 : WIDE);
+      }
+      for (int i = 0; i < tasks.size(); i++) {
+        int status = tasks[i]->status, priority = tasks[i]->priority;
+        if (fits(status) && fits(priority)) continue;
+        write_varint(out, zigzag(status));
+        write_varint(out, zigzag(priority));
+      }
+      long previous = 0;
+      for (int i = 0; i < tasks.size(); i++) {
+        write_date(out, tasks[i]->start_date, previous);
+        write_date(out, tasks[i]->due_date, previous);
+      }
+      for (size_t k = 0; k < stream.size();) {
+        uint32_t count = stream[k++];
+        write_varint(out, count);
+        for (uint32_t j = 0; j < count; j++, k++) {
+          if (stream[k] & 1) write_varint(out, stream[k]);
+          else write_varint(out, (uint64_t)ids[stream[k] >> 1] << 1);
+        }
+      }
+    }
+
+    /**
+     * A function to read a block of tasks.
+     * @param p The current position, at the start of the block, advanced past it
+     * @param end The end of the buffer
+     * @param out The list to add the tasks to, which is only changed if the whole block is read
+     * @returns True if the block was read, false otherwise
+     */
+    static bool read_tasks(const char*& p, const char* end, vector<Task>& out) {
+      if (end - p < 4 || string(p, 4) != "TSKP") return false;
+      p += 4;
+      uint64_t count, size, id;
+      if (!read_varint(p, end, count) || !read_varint(p, end, size)) return false;
+      if (count > (uint64_t)(end - p) || size > (uint64_t)(end - p)) return false;
+      vector<string> dictionary(size);
+      for (uint64_t i = 0; i < size; i++) {
+        if (!read_bytes(p, end, dictionary[i])) return false;
+      }
+
+      vector<Task> tasks(count);
+      for (uint64_t i = 0; i < count; i++) {
+        if (!read_varint(p, end, id) || id >= size) return false;
+        tasks[i].username = dictionary[id];
+      }
+      if ((uint64_t)(end - p) < count) return false;
+      const char* fields = p;
+      p += count;
+      for (uint64_t i = 0; i < count; i++) {
+        unsigned char byte = fields[i];
+        if (byte != WIDE) {
+          if (byte >= 64) return false;
+          tasks[i].status = (TaskStatus)(byte & 7);
+          tasks[i].priority = (Priority)(byte >> 3);
+          continue;
+        }
+        uint64_t status, priority;
+        if (!read_varint(p, end, status) || !read_varint(p, end, priority)) return false;
+        long values[2] = { unzigzag(status), unzigzag(priority) };
+        for (int j = 0; j < 2; j++) {
+          if (values[j] < std::numeric_limits<int>::min() || values[j] > std::numeric_limits<int>::max()) return false;
+        }
+        tasks[i].status = (TaskStatus)values[0];
+        tasks[i].priority = (Priority)values[1];
+      }
+      long previous = 0;
+      DateCache dates(1024);
+      for (uint64_t i = 0; i < count; i++) {
+        if (!read_date(p, end, tasks[i].start_date, previous, dates)) return false;
+        if (!read_date(p, end, tasks[i].due_date, previous, dates)) return false;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+        if (!read_text(p, end, dictionary, tasks[i].title)) return false;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+        if (!read_text(p, end, dictionary, tasks[i].description)) return false;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+        uint64_t tag_count;
+        if (!read_varint(p, end, tag_count) || tag_count > (uint64_t)(end - p)) return false;
+        tasks[i].tags.resize(tag_count);
+        for (uint64_t j = 0; j < tag_count; j++) {
+          if (!read_varint(p, end, id) || (id & 1) || (id >> 1) >= size) return false;
+          tasks[i].tags[j] = dictionary[id >> 1];
+        }
+      }
+      if (out.empty()) out.swap(tasks);
+      else out.insert(out.end(), std::make_move_iterator(tasks.begin()), std::make_move_iterator(tasks.end()));
+      return true;
+    }
+  };
+
+  /**
+   * A class to run work on a pool of threads, one per core.
+   */
+  class Parallel {
+    public:
+    /**
+     * A function to run a job for each number from 0 to count - 1.
+     * The jobs are handed out to the threads as they finish, so uneven jobs still keep every core busy.
+     * @param count The number of jobs
+     * @param job The function to run for each job, which may be called on any thread
+     */
+    static void for_each(int count, const std::function<void(int)>& job) {
+      int threads = std::min<int>(count, std::max(1u, std::thread::hardware_concurrency()));
+      if (threads <= 1) {
+        for (int i = 0; i < count; i++) job(i);
+        return;
+      }
+
+      std::atomic<int> next(0);
+      vector<std::thread> pool;
+      for (int t = 0; t < threads; t++) {
+        pool.push_back(std::thread([&]() {
+          for (int i = next++; i < count; i = next++) job(i);
+        }));
+      }
+      for (int t = 0; t < threads; t++)
+        pool[t].join();
+    }
+  };
+}
+
+/**
+ * A namespace to provide the containers the database keeps its tasks in.
+ */
+namespace Store {
+  /**
+   * A class representing a list of tasks that can be copied in constant time.
+   * The tasks are kept in fixed size chunks behind shared pointers, and a copy shares the table of chunks with the original.
+   * A table or chunk is only copied when it is changed while shared, so a copy taken as a snapshot never sees later edits.
+   * Tables and chunks that no copy uses any more are freed by their reference counts.
+   * A snapshot can be read on another thread while the original is edited, but every copy of the list must be made and
+   * destroyed on the thread that edits it, since ownership is decided from the reference counts.
+   */
+  class TaskList {
+    private:
+    static const int CHUNK_SIZE = 1024; /**< The number of tasks in each chunk */
+    typedef vector<Task> Chunk; /**< A chunk of tasks */
+    typedef vector<std::shared_ptr<Chunk>> Table; /**< The chunks of the list, in order */
+
+    std::shared_ptr<Table> table = std::make_shared<Table>(); /**< The chunks of the list, shared with any snapshots */
+    size_t count = 0; /**< The number of tasks in the list */
+
+    /**
+     * A function to get the table of chunks, copying it first if it is shared.
+     * The reference count can only rise above one through a copy of this list, so a count of one means the table is ours.
+     * @returns The table, which is not shared with any other list
+     */
+    Table& own_table() {
+      if (table.use_count() > 1) table = std::make_shared<Table>(*table);
+      return *table;
+    }
+    /**
+     * A function to get a chunk, copying it first if it is shared.
+     * @param index The position of the chunk in the table
+     * @returns The chunk, which is not shared with any other list
+     */
+    Chunk& own_chunk(size_t index) {
+      Table& chunks = own_table();
+      if (chunks[index].use_count() > 1) chunks[index] = std::make_shared<Chunk>(*chunks[index]);
+      return *chunks[index];
+    }
+
+    public:
+    /**
+     * A constructor to create an empty list.
+     */
+    TaskList() {}
+    /**
+     * A constructor to create a list from a vector of tasks.
+     * @param tasks The tasks to copy into the list
+     */
+    TaskList(const vector<Task>& tasks) {
+      reserve(tasks.size());
+      for (int i = 0; i < tasks.size(); i++) push_back(tasks[i]);
+    }
+
+    /**
+     * A function to get the number of tasks in the list.
+     * @returns The number of tasks
+     */
+    size_t size() const {
+      return count;
+    }
+    /**
+     * A function to read a task.
+     * @param i The position of the task
+     * @returns The task, which must not be changed; use edit to change it
+     */
+    const Task& operator[](size_t i) const {
+      return (*(*table)[i / CHUNK_SIZE])[i % CHUNK_SIZE];
+    }
+    /**
+     * A function to change a task in place.
+     * The chunk holding the task is copied first if a snapshot shares it.
+     * @param i The position of the task
+     * @returns The task, which may be changed
+     */
+    Task& edit(size_t i) {
+      return own_chunk(i / CHUNK_SIZE)[i % CHUNK_SIZE];
+    }
+    /**
+     * A function to replace a task.
+     * @param i The position of the task
+     * @param task The new value of the task
+     */
+    void set(size_t i, const Task& task) {
+      edit(i) = task;
+    }
+    /**
+     * A function to add a task to the end of the list.
+     * @param task The task to add
+     */
+    void push_back(Task task) {
+      if (count % CHUNK_SIZE == 0) {
+        own_table().push_back(std::make_shared<Chunk>());
+        table->back()->reserve(CHUNK_SIZE);
+      }
+      own_chunk(count / CHUNK_SIZE).push_back(std::move(task));
+      count++;
+    }
+    /**
+     * A function to remove a task, moving the following tasks down by one.
+     * @param i The position of the task
+     */
+    void erase(size_t i) {
+      size_t first = i / CHUNK_SIZE;
+      Chunk& chunk = own_chunk(first);
+      chunk.erase(chunk.begin() + i % CHUNK_SIZE);
+      for (size_t c = first + 1; c < table->size(); c++) {
+        Chunk& next = own_chunk(c);
+        own_chunk(c - 1).push_back(std::move(next.front()));
+        next.erase(next.begin());
+      }
+      count--;
+      if (table->back()->empty()) table->pop_back();
+    }
+    /**
+     * A function to remove every task that matches a predicate in one pass.
+     * The tasks that are kept are moved down over the removed ones in order, like std::remove_if.
+     * @param predicate The function that returns true for the tasks to remove
+     * @returns The number of tasks removed
+     */
+    size_t remove_if(const std::function<bool(const Task&)>& predicate) {
+      size_t kept = 0;
+      for (size_t i = 0; i < count; i++) {
+        if (predicate((*this)[i])) continue;
+        if (kept != i) edit(kept) = std::move(edit(i));
+        kept++;
+      }
+      size_t removed = count - kept;
+      if (removed == 0) return 0;
+
+      // Drop the chunks past the new end, and the tail of the last chunk
+      count = kept;
+      Table& chunks = own_table();
+      chunks.resize((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+      if (count % CHUNK_SIZE != 0) own_chunk(chunks.size() - 1).resize(count % CHUNK_SIZE);
+      return removed;
+    }
+    /**
+     * A function to reserve space for the chunks of a number of tasks.
+     * @param n The number of tasks
+     */
+    void reserve(size_t n) {
+      own_table().reserve((n + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    }
+    /**
+     * A function to remove every task.
+     */
+    void clear() {
+      table = std::make_shared<Table>();
+      count = 0;
+    }
+    /**
+     * A function to take a snapshot of the list in constant time.
+     * @returns A list with the current tasks, which later edits to this list do not change
+     */
+    TaskList snapshot() const {
+      return *this;
+    }
+    /**
+     * A function to copy the tasks into a vector.
+     * @returns The tasks
+     */
+    vector<Task> to_vector() const {
+      vector<Task> result;
+      result.reserve(count);
+      for (size_t i = 0; i < count; i++) result.push_back((*this)[i]);
+      return result;
+    }
+  };
+}
+
+/**
+ * A namespace to provide indexes over the tasks in the database.
+ * The indexes store the positions of the tasks in the database, so when a task is removed the positions after it are shifted down by one.
+ */
+namespace Index {
+  /**
+   * A class representing an ordered index over one of the date fields of the tasks.
+   * The entries are keyed on the username and the date, so the tasks of each user are kept in date order.
+   * Dates in the "YYYY-MM-DD" format sort the same as strings, so no parsing is needed.
+   * Range queries take O(log n + k) time, where k is the number of tasks in the range.
+   * Each entry holds a handle into a vector of positions, so shifting the positions after a deletion scans a flat
+   * vector rather than walking the tree.
+   */
+  class DateIndex {
+    private:
+    string Task::*field; /**< The date field of the task that is indexed */
+    std::multimap<std::pair<string, string>, int> entries; /**< The username and date of each task mapped to the handle of its position */
+    vector<int> positions; /**< The position in the database of each handle, or -1 if the handle is free */
+    vector<int> free_handles; /**< The handles of removed entries, which are reused first */
+
+    public:
+    /**
+     * A constructor to create an index over a date field.
+     * @param field The date field of the task to index, e.g. &Task::due_date
+     */
+    DateIndex(string Task::*field) : field(field) {}
+
+    /**
+     * A function to rebuild the index from a list of tasks.
+     * The tasks are grouped by user and each group is sorted by date, which is much cheaper than sorting every key at
+     * once, and the keys are then appended at the end of the tree in order. Tasks with the same key stay in database
+     * order, as they would if they were inserted one by one.
+     * @param tasks The list of tasks to index
+     */
+    void build(const Store::TaskList& tasks) {
+      entries.clear();
+      free_handles.clear();
+      positions.resize(tasks.size());
+      std::unordered_map<string, vector<int>> groups;
+      for (int i = 0; i < tasks.size(); i++) {
+        positions[i] = i;
+        groups[tasks[i].username].push_back(i);
+      }
+      vector<std::pair<const string, vector<int>>*> users;
+      users.reserve(groups.size());
+      for (auto it = groups.begin(); it != groups.end(); ++it) users.push_back(&*it);
+      std::sort(users.begin(), users.end(), [](const std::pair<const string, vector<int>>* a, const std::pair<const string, vector<int>>* b) {
+        return a->first < b->first;
+      });
+
+      for (int i = 0; i < users.size(); i++) {
+        vector<int>& ids = users[i]->second;
+        std::stable_sort(ids.begin(), ids.end(), [&](int a, int b) { return tasks[a].*field < tasks[b].*field; });
+        for (int j = 0; j < ids.size(); j++)
+          entries.emplace_hint(entries.end(), std::make_pair(users[i]->first, tasks[ids[j]].*field), ids[j]);
+      }
+    }
+    /**
+     * A function to add a task to the index.
+     * @param task The task to add
+     * @param id The position of the task in the database
+     */
+    void insert(const Task& task, int id) {
+      int handle = positions.size();
+      if (!free_handles.empty()) {
+        handle = free_handles.back();
+        free_handles.pop_back();
+        positions[handle] = id;
+      }
+      else positions.push_back(id);
+      entries.emplace(std::make_pair(task.username, task.*field), handle);
+    }
+    /**
+     * A function to remove a task from the index.
+     * @param task The task to remove, with the date it was indexed under
+     * @param id The position of the task in the database
+     */
+    void remove(const Task& task, int id) {
+      auto range = entries.equal_range(std::make_pair(task.username, task.*field));
+      for (auto it = range.first; it != range.second; it++) {
+        if (positions[it->second] == id) {
+          positions[it->second] = -1;
+          free_handles.push_back(it->second);
+          entries.erase(it);
+          return;
+        }
+      }
+    }
+    /**
+     * A function to remove a task that is deleted from the database.
+     * The positions after it are shifted down by one, which keeps the order of the entries.
+     * @param task The task to remove
+     * @param id The position of the task in the database
+     */
+    void erase(const Task& task, int id) {
+      remove(task, id);
+      for (int i = 0; i < positions.size(); i++) {
+        if (positions[i] > id) positions[i]--;
+      }
+    }
+    /**
+     * A function to find the tasks of a user with a date in a range.
+     * @param username The username of the user
+     * @param from The first date in the range, inclusive
+     * @param to The last date in the range, exclusive
+     * @returns The positions of the tasks in date order
+     */
+    vector<int> range(const string& username, const string& from, const string& to) const {
+      vector<int> result;
+      auto first = entries.lower_bound(std::make_pair(username, from));
+      auto last = entries.lower_bound(std::make_pair(username, to));
+      for (auto it = first; it != last; it++)
+        result.push_back(positions[it->second]);
+      return result;
+    }
+    /**
+     * A function to find all the tasks of a user in date order.
+     * @param username The username of the user
+     * @returns The positions of the tasks in date order
+     */
+    vector<int> all(const string& username) const {
+      vector<int> result;
+      auto first = entries.lower_bound(std::make_pair(username, string()));
+      for (auto it = first; it != entries.end() && it->first.first == username; it++)
+        result.push_back(positions[it->second]);
+      return result;
+    }
+  };
+
+  /**
+   * A class representing a reminder scheduler for the tasks that are not completed.
+   * Each user has a min-heap of due dates, so the next due task is found without scanning the tasks.
+   * Entries are not removed when a task changes; stale entries are skipped when they reach the top of the heap.
+   * A heap is compacted once its stale entries outnumber the open tasks of its user, so edits do not grow it without limit.
+   */
+  class Reminders {
+    private:
+    typedef std::pair<string, int> Entry; /**< The due date and the position of a task */
+    /**
+     * A struct representing the reminders of one user.
+     */
+    struct Heap {
+      vector<Entry> entries; /**< The entries, as a min-heap */
+      int open = 0; /**< The number of open tasks of the user, each of which has at least one current entry */
+    };
+    std::map<string, Heap> heaps; /**< The heap of each user */
+
+    /**
+     * A function to check if a heap entry still matches the task it points to.
+     * @param entry The heap entry to check
+     * @param username The username of the heap the entry is in
+     * @param tasks The list of tasks in the database
+     * @returns True if the task is still due on that date and not completed, false otherwise
+     */
+    static bool is_current(const Entry& entry, const string& username, const Store::TaskList& tasks) {
+      if (entry.second >= tasks.size()) return false;
+      const Task& task = tasks[entry.second];
+      return task.username == username && task.due_date == entry.first && task.status != COMPLETED;
+    }
+    /**
+     * A function to drop the stale and repeated entries of a heap.
+     * A sorted vector is a valid min-heap, so the heap does not need to be rebuilt afterwards.
+     * @param heap The heap to compact
+     * @param username The username of the heap
+     * @param tasks The list of tasks in the database
+     */
+    static void compact(Heap& heap, const string& username, const Store::TaskList& tasks) {
+      vector<Entry>& entries = heap.entries;
+      entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+        return !is_current(entry, username, tasks);
+      }), entries.end());
+      std::sort(entries.begin(), entries.end());
+      entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    }
+
+    public:
+    /**
+     * A function to rebuild the heaps from a list of tasks.
+     * @param tasks The list of tasks to schedule
+     */
+    void build(const Store::TaskList& tasks) {
+      heaps.clear();
+      for (int i = 0; i < tasks.size(); i++)
+        schedule(tasks[i], i, tasks);
+    }
+    /**
+     * A function to schedule a reminder for a task that was added or changed.
+     * Completed tasks are not scheduled. The task must already be in the list of tasks.
+     * @param task The task to schedule
+     * @param id The position of the task in the database
+     * @param tasks The list of tasks in the database
+     */
+    void schedule(const Task& task, int id, const Store::TaskList& tasks) {
+      if (task.status == COMPLETED) return;
+      Heap& heap = heaps[task.username];
+      heap.entries.push_back(Entry{task.due_date, id});
+      std::push_heap(heap.entries.begin(), heap.entries.end(), std::greater<Entry>());
+      heap.open++;
+      if (heap.entries.size() > 2 * heap.open) compact(heap, task.username, tasks);
+    }
+    /**
+     * A function to unschedule a task before it is changed.
+     * The entry of the task is left in the heap, and is dropped when it reaches the top or the heap is compacted.
+     * @param task The task, with the values it was scheduled with
+     */
+    void unschedule(const Task& task) {
+      if (task.status == COMPLETED) return;
+      auto it = heaps.find(task.username);
+      if (it != heaps.end()) it->second.open--;
+    }
+    /**
+     * A function to remove a task that is deleted from the database.
+     * The entries of the task are dropped, and the positions after it are shifted down by one.
+     * @param task The task to remove
+     * @param id The position of the task in the database
+     */
+    void erase(const Task& task, int id) {
+      unschedule(task);
+      for (auto it = heaps.begin(); it != heaps.end(); ++it) {
+        vector<Entry>& entries = it->second.entries;
+        if (it->first == task.username) {
+          entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+            return entry.second == id;
+          }), entries.end());
+          std::make_heap(entries.begin(), entries.end(), std::greater<Entry>());
+        }
+        for (int i = 0; i < entries.size(); i++) {
+          if (entries[i].second > id) entries[i].second--;
+        }
+      }
+    }
+    /**
+     * A function to find the next due task of a user.
+     * Stale entries at the top of the heap are discarded.
+     * @param username The username of the user
+     * @param tasks The list of tasks in the database
+     * @returns The position of the next due task, or -1 if the user has no open tasks
+     */
+    int next(const string& username, const Store::TaskList& tasks) {
+      auto it = heaps.find(username);
+      if (it == heaps.end()) return -1;
+      vector<Entry>& entries = it->second.entries;
+      while (!entries.empty() && !is_current(entries.front(), username, tasks)) {
+        std::pop_heap(entries.begin(), entries.end(), std::greater<Entry>());
+        entries.pop_back();
+      }
+      return entries.empty() ? -1 : entries.front().second;
+    }
+  };
+
+  /**
+   * A class representing a scheduler that suggests the tasks to work on next.
+   * Each user has an indexed min-heap of their open tasks, ordered by priority, then due date, then status, with tasks
+   * in progress before tasks still to do. Completed tasks are not kept.
+   * The heap slot of each task is kept, so a task can be moved or removed in O(log n) when it changes,
+   * and the best k tasks are found in O(k log k) without changing the heap.
+   */
+  class Scheduler {
+    private:
+    /**
+     * A struct representing a task in a heap, with a copy of the fields it is ordered by.
+     */
+    struct Entry {
+      int priority; /**< The priority of the task, where smaller is more urgent */
+      string due_date; /**< The due date of the task */
+      int status; /**< 0 for a task in progress, 1 for a task still to do */
+      int id; /**< The position of the task in the database */
+
+      bool operator<(const Entry& other) const {
+        if (priority != other.priority) return priority < other.priority;
+        if (due_date != other.due_date) return due_date < other.due_date;
+        if (status != other.status) return status < other.status;
+        return id < other.id;
+      }
+    };
+    std::map<string, vector<Entry>> heaps; /**< The heap of each user, as an array where the children of slot i are 2i + 1 and 2i + 2 */
+    vector<int> slots; /**< The heap slot of each task by position, or -1 if the task is not scheduled */
+
+    /**
+     * A function to make an entry for a task.
+     * @param task The task
+     * @param id The position of the task in the database
+     * @returns The entry
+     */
+    static Entry entry_of(const Task& task, int id) {
+      return Entry{ task.priority, task.due_date, task.status == IN_PROGRESS ? 0 : 1, id };
+    }
+    /**
+     * A function to put an entry into a heap slot and record the slot.
+     * @param heap The heap
+     * @param slot The slot
+     * @param entry The entry
+     */
+    void place(vector<Entry>& heap, int slot, Entry entry) {
+      slots[entry.id] = slot;
+      heap[slot] = std::move(entry);
+    }
+    /**
+     * A function to move the entry in a slot down until it is before both its children.
+     * @param heap The heap
+     * @param slot The slot of the entry
+     * @returns The slot the entry ends up in
+     */
+    int sift_down(vector<Entry>& heap, int slot) {
+      Entry entry = std::move(heap[slot]);
+      while (2 * slot + 1 < heap.size()) {
+        int child = 2 * slot + 1;
+        if (child + 1 < heap.size() && heap[child + 1] < heap[child]) child++;
+        if (!(heap[child] < entry)) break;
+        place(heap, slot, std::move(heap[child]));
+        slot = child;
+      }
+      place(heap, slot, std::move(entry));
+      return slot;
+    }
+    /**
+     * A function to move the entry in a slot up or down until the heap is ordered again.
+     * @param heap The heap
+     * @param slot The slot of the entry that changed
+     */
+    void restore(vector<Entry>& heap, int slot) {
+      if (sift_down(heap, slot) != slot) return;
+      Entry entry = std::move(heap[slot]);
+      while (slot > 0 && entry < heap[(slot - 1) / 2]) {
+        place(heap, slot, std::move(heap[(slot - 1) / 2]));
+        slot = (slot - 1) / 2;
+      }
+      place(heap, slot, std::move(entry));
+    }
+
+    /**
+     * A function to take a task out of its heap, filling its slot with the last entry.
+     * @param heap The heap of the task
+     * @param id The position of the task in the database
+     */
+    void remove(vector<Entry>& heap, int id) {
+      int slot = slots[id];
+      if (slot < 0) return;
+      slots[id] = -1;
+      Entry last = std::move(heap.back());
+      heap.pop_back();
+      if (slot < heap.size()) {
+        place(heap, slot, std::move(last));
+        restore(heap, slot);
+      }
+    }
+
+    public:
+    /**
+     * A function to rebuild the heaps from a list of tasks.
+     * The heaps are built bottom up, which takes O(n).
+     * @param tasks The list of tasks to schedule
+     */
+    void build(const Store::TaskList& tasks) {
+      heaps.clear();
+      slots.assign(tasks.size(), -1);
+      for (int i = 0; i < tasks.size(); i++) {
+        if (tasks[i].status == COMPLETED) continue;
+        vector<Entry>& heap = heaps[tasks[i].username];
+        slots[i] = heap.size();
+        heap.push_back(entry_of(tasks[i], i));
+      }
+      for (auto it = heaps.begin(); it != heaps.end(); ++it) {
+        for (int slot = it->second.size() / 2 - 1; slot >= 0; slot--)
+          sift_down(it->second, slot);
+      }
+    }
+    /**
+     * A function to add, move or remove a task after it is added or changed.
+     * The username of a task must not change.
+     * @param task The new value of the task
+     * @param id The position of the task in the database
+     */
+    void update(const Task& task, int id) {
+      if (id >= slots.size()) slots.resize(id + 1, -1);
+      vector<Entry>& heap = heaps[task.username];
+      int slot = slots[id];
+
+      if (task.status == COMPLETED) {
+        remove(heap, id);
+        return;
+      }
+      if (slot < 0) {
+        slot = heap.size();
+        heap.emplace_back();
+      }
+      place(heap, slot, entry_of(task, id));
+      restore(heap, slot);
+    }
+    /**
+     * A function to remove a task that is deleted from the database.
+     * The positions after it are shifted down by one, which keeps the order of the entries.
+     * @param task The task to remove
+     * @param id The position of the task in the database
+     */
+    void erase(const Task& task, int id) {
+      if (id >= slots.size()) return;
+      auto it = heaps.find(task.username);
+      if (it != heaps.end()) remove(it->second, id);
+      slots.erase(slots.begin() + id);
+      for (auto heap = heaps.begin(); heap != heaps.end(); ++heap) {
+        for (int slot = 0; slot < heap->second.size(); slot++) {
+          if (heap->second[slot].id > id) heap->second[slot].id--;
+        }
+      }
+    }
+    /**
+     * A function to find the tasks a user should work on next.
+     * The heap is searched best first from the root, keeping the children of each task taken as candidates.
+     * @param username The username of the user
+     * @param count The largest number of tasks to return
+     * @returns The positions of the tasks, most pressing first
+     */
+    vector<int> top(const string& username, int count) const {
+      vector<int> result;
+      auto it = heaps.find(username);
+      if (it == heaps.end() || it->second.empty()) return result;
+      const vector<Entry>& heap = it->second;
+
+      auto later = [&](int a, int b) { return heap[b] < heap[a]; };
+      std::priority_queue<int, vector<int>, decltype(later)> candidates(later);
+      candidates.push(0);
+      while (!candidates.empty() && result.size() < count) {
+        int slot = candidates.top();
+        candidates.pop();
+        result.push_back(heap[slot].id);
+        if (2 * slot + 1 < heap.size()) candidates.push(2 * slot + 1);
+        if (2 * slot + 2 < heap.size()) candidates.push(2 * slot + 2);
+      }
+      return result;
+    }
+  };
+}
+
+class Menu {
+  private:
+  /**
+   * A function to display a line of dashes to separate sections of the menu.
+   */
+  static void print_line() {
+    write_line("---------------------------------");
+  } 
+  /**
+   * A function to display a line of dashes to separate sections of the menu.
+   * @param heading The heading to display in the menu.
+   */
+  static void print_heading(string heading) {
+    write_line();
+    print_line();
+    write_line("Tasky - " + heading);
+    print_line();
+  }
+
+  public:
+  /**
+   * A function to display the main menu for the user.
+   */
+  static void display_user_menu() {
+    print_heading("Main Menu");
+    write_line("1. Login");
+    write_line("2. Register");
+    write_line("3. Exit");
+  }
+  /**
+   * A function to display the login or register screen for the user.
+   * @param heading The heading to display in the menu.
+   * @return The user entered by the user.
+   */
+  static User display_login_or_register(string heading) {
+    print_heading(heading);
+    string username = Helper::Reader::read_string("Username: ");
+    string password = Helper::Reader::read_string("Password: ");
+    return User{username, password};
+  }
+  /**
+   * A function to display the main menu for the user.
+   */
+  static void display_main_menu() {
+    print_heading("Main Menu");
+    write_line("1. Add Task");
+    write_line("2. View Task");
+    write_line("3. Select Task");
+    write_line("4. What Should I Work on Next?");
+    write_line("5. Bulk Actions");
+    write_line("6. Logout");
+  }
+
+  /**
+   * A function to display a task to the user.
+   * @param task The task to display.
+   * @param id The id of the task.
+   */
+  static void display_task(const Task& task, int id) {
+    write_line();
+    write_line("ID: " + to_string(id));
+    write_line("Title: " + task.title);
+    write_line("Description: " + task.description);
+    write_line("Status: " + to_string(task.status));
+    write_line("Priority: " + to_string(task.priority));
+    write_line("Due Date: " + task.due_date);
+    write_line("Start Date: " + task.start_date);
+    if (task.tags.size() > 0) write_line("Tags: " + to_string(task.tags));
+  }
+  /**
+   * A function to display a list of tasks to the user.
+   * @param tasks The list of tasks to display.
+   */
+  static void display_tasks(const vector<Task> &tasks, User user) {
+    for (int i = 0; i < tasks.size(); i++) {
+      if (tasks[i].username == user.username)
+        display_task(tasks[i], i);
+    }
+  }
+  /**
+   * A function to display a list of tasks to the user with a heading.
+   * @param tasks The list of tasks to display.
+   * @param heading The heading to display.
+   */
+  static void display_tasks(const vector<Task>& tasks, string heading, User user) {
+    print_heading(heading);
+    display_tasks(tasks, user);
+  }
+  /**
+   * A function to display the tasks in the database to the user with a heading.
+   * @param tasks The list of tasks in the database.
+   * @param heading The heading to display.
+   */
+  static void display_tasks(const Store::TaskList& tasks, string heading, User user) {
+    print_heading(heading);
+    for (int i = 0; i < tasks.size(); i++) {
+      if (tasks[i].username == user.username)
+        display_task(tasks[i], i);
+    }
+  }
+  /**
+   * A function to display a selection of tasks from the database with a heading.
+   * @param tasks The list of tasks in the database.
+   * @param ids The positions of the tasks to display.
+   * @param heading The heading to display.
+   */
+  static void display_tasks(const Store::TaskList& tasks, const vector<int>& ids, string heading) {
+    print_heading(heading);
+    for (int i = 0; i < ids.size(); i++)
+      display_task(tasks[ids[i]], ids[i]);
+  }
+  /**
+   * A function to display a reminder for the next due task.
+   * @param task The next due task.
+   * @param overdue Whether the task is already overdue.
+   */
+  static void display_reminder(const Task& task, bool overdue) {
+    write_line();
+    if (overdue) write_line("Reminder: \"" + task.title + "\" was due on " + task.due_date + ".");
+    else write_line("Reminder: \"" + task.title + "\" is due on " + task.due_date + ".");
+  }
+  /**
+   * A function to display the add task screen for the user.
+   * @return The task entered by the user.
+   */
+  static Task display_add_task() {
+    print_heading("Add Task");
+    string title = Helper::Reader::read_string("Title: ");
+    string description = Helper::Reader::read_string("Description: ");
+    TaskStatus status = (TaskStatus)Helper::Reader::read_integer("Status (1. TODO, 2. IN PROGRESS, 3. DONE): ", 1, 3);
+    Priority priority = (Priority)Helper::Reader::read_integer("Priority (1. URGENT, 2. HIGH, 3. NORMAL, 4. LOW): ", 1, 4);
+    string start_date = Helper::Reader::read_date("Start Date (YYYY-MM-DD): ");
+    string due_date = Helper::Reader::read_date("Due Date (YYYY-MM-DD): ");
+    vector<string> tags = Helper::Reader::read_tags("Tags (separated by commas): ");
+    return Task{"", title, description, status, priority, due_date, start_date, tags};
+  }
+  /**
+   * A function to display the view task screen for the user.
+   */
+  static void display_view_task_menu() {
+    print_heading("View Task");
+    write_line("1. View All Tasks");
+    write_line("2. View Tasks by Status");
+    write_line("3. View Tasks by Priority");
+    write_line("4. View Tasks by Due Date");
+    write_line("5. View Tasks by Start Date");
+    write_line("6. View Overdue Tasks");
+    write_line("7. View Tasks Due Soon");
+    write_line("8. Back");
+  }
+  /**
+   * A function to display the bulk actions screen for the user.
+   */
+  static void display_bulk_menu() {
+    print_heading("Bulk Actions");
+    write_line("1. Complete All Tasks with a Tag");
+    write_line("2. Delete Completed Tasks Due Before a Date");
+    write_line("3. Reprioritize Overdue Tasks");
+    write_line("4. Back");
+  }
+  /**
+   * A function to display the select task screen for the user.
+   */
+  static void display_select_task_menu() {
+    print_heading("Select Task");
+    write_line("1. Complete Task");
+    write_line("2. Update Task");
+    write_line("3. Delete Task");
+    write_line("4. Back");
+  }
+  /**
+   * A function to display the update task screen for the user.
+   */
+  static void display_sort_task_menu() {
+    print_heading("Sort Task");
+    write_line("1. Sort by Due Date");
+    write_line("2. Sort by Start Date");
+    write_line("3. Back");
+  }
+};
+
+/**
+ * A struct representing a database with a list of users and tasks.
+ * The database stores the users in a vector and the tasks in a Store::TaskList, which can be snapshotted for a background save.
+ * On disk, the tasks are split by a hash of their username into shard files, listed by a manifest that also holds the users.
+ * Shards are loaded in parallel, and only the shards that have changed are written when saving.
+ */
+struct Database {
+  vector<User> users; /**< The list of users in the database */ 
+  Store::TaskList tasks; /**< The list of tasks in the database, which can be snapshotted while it is edited */
+  string file_name = "data.json"; /**< The name of the store in the json directory; shards are kept in a directory of the same name */
+  int shard_count = 16; /**< The number of shard files the tasks are split into, read from the manifest when loading */
+  bool packed = false; /**< Whether the shards are stored in the compact binary format instead of json, read from the manifest when loading */
+
+  vector<bool> dirty_shards; /**< Whether each shard has changed since it was loaded or saved */
+  bool users_dirty = false; /**< Whether the users have changed since they were loaded or saved */
+  vector<bool> unreadable_shards; /**< Whether each shard could not be read, in which case it is never written so the tasks in it are not lost */
+  bool read_only = false; /**< Whether the manifest or the unsharded file could not be read, in which case nothing is written */
+  bool shards_complete = false; /**< Whether every shard file has been written, so a missing one was lost rather than never written */
+  vector<std::shared_ptr<std::ifstream>> shard_files; /**< The shard files, opened when the first task description and tags are loaded from them */
+  Store::TaskList pending_snapshot; /**< The tasks being written by the save running in the background, released by finish_save on this thread */
+  std::shared_future<bool> pending_save; /**< The result of the save running in the background, if any; declared after the snapshot so it waits for the save before the snapshot is destroyed */
+  vector<int> pending_shards; /**< The shards being written by the save running in the background */
+  bool pending_users = false; /**< Whether the save running in the background is writing the manifest */
+  std::shared_ptr<Shared::Writer> shared; /**< The shared memory region the data is published to, if any */
+  unsigned long changes = 0; /**< The number of changes made to the users and tasks */
+  unsigned long published_changes = 0; /**< The number of changes when the data was last published */
+
+  Index::DateIndex due_index{&Task::due_date}; /**< The tasks ordered by due date */
+  Index::DateIndex start_index{&Task::start_date}; /**< The tasks ordered by start date */
+  Index::Reminders reminders; /**< The open tasks of each user ordered by due date */
+  Index::Scheduler scheduler; /**< The open tasks of each user ordered by priority, due date and status */
+
+  /**
+   * A function to rebuild the indexes from the tasks vector.
+   * The function is called after tasks are added, changed or removed in bulk, where rebuilding costs less than updating the indexes for each task.
+   * The indexes only read the tasks, so each is built on its own thread.
+   */
+  void index_tasks() {
+    METRICS_TIMER("index_tasks");
+    Helper::Parallel::for_each(4, [&](int index) {
+      if (index == 0) due_index.build(tasks);
+      else if (index == 1) start_index.build(tasks);
+      else if (index == 2) reminders.build(tasks);
+      else scheduler.build(tasks);
+    });
+  }
+
+  /**
+   * A function to get the shard a user's tasks are stored in.
+   * The FNV-1a hash is used, so the shard of a user does not change between builds.
+   * @param username The username of the user.
+   * @returns The number of the shard.
+   */
+  int shard_of(const string& username) const {
+    return shard_of(username, shard_count);
+  }
+
+  /**
+   * A function to get the shard a user's tasks are stored in, for a given number of shards.
+   * @param username The username of the user.
+   * @param shard_count The number of shards.
+   * @returns The number of the shard.
+   */
+  static int shard_of(const string& username, int shard_count) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < username.size(); i++) {
+      hash ^= (unsigned char)username[i];
+      hash *= 16777619u;
+    }
+    return hash % shard_count;
+  }
+
+  /**
+   * A function to mark the shard of a task as changed, so it is written on the next save.
+   * @param task The task that changed.
+   */
+  void mark_dirty(const Task& task) {
+    changes++;
+    if (dirty_shards.size() != shard_count) dirty_shards.resize(shard_count, false);
+    dirty_shards[shard_of(task.username)] = true;
+  }
+
+  /**
+   * A function to add a user to the database.
+   * @param user The user to add.
+   */
+  void add_user(const User& user) {
+    users.push_back(user);
+    users_dirty = true;
+    changes++;
+  }
+
+  /**
+   * A function to add a task to the database and its indexes.
+   * @param task The task to add.
+   */
+  void add_task(const Task& task) {
+    int id = tasks.size();
+    tasks.push_back(task);
+    mark_dirty(task);
+    due_index.insert(task, id);
+    start_index.insert(task, id);
+    reminders.schedule(task, id, tasks);
+    scheduler.update(task, id);
+  }
+
+  /**
+   * A function to add many tasks to the database at once.
+   * The indexes are rebuilt once at the end rather than updated for each task.
+   * @param batch The tasks to add, moved into the database.
+   */
+  void add_tasks(vector<Task>& batch) {
+    METRICS_TIMER("add_tasks");
+    tasks.reserve(tasks.size() + batch.size());
+    for (int i = 0; i < batch.size(); i++) {
+      mark_dirty(batch[i]);
+      tasks.push_back(std::move(batch[i]));
+    }
+    batch.clear();
+    index_tasks();
+  }
+
+  /**
+   * A function to replace a task in the database and update its indexes.
+   * @param id The position of the task to replace.
+   * @param task The new value of the task.
+   */
+  void update_task(int id, const Task& task) {
+    METRICS_TIMER("update_task");
+    due_index.remove(tasks[id], id);
+    start_index.remove(tasks[id], id);
+    reminders.unschedule(tasks[id]);
+    mark_dirty(tasks[id]);
+    tasks.set(id, task);
+    mark_dirty(task);
+    due_index.insert(task, id);
+    start_index.insert(task, id);
+    reminders.schedule(task, id, tasks);
+    scheduler.update(task, id);
+  }
+
+  /**
+   * A function to delete a task from the database.
+   * The task is removed from the indexes, and the positions of the following tasks are shifted down by one.
+   * @param id The position of the task to delete.
+   */
+  void delete_task(int id) {
+    METRICS_TIMER("delete_task");
+    METRICS_COUNT("tasks_deleted");
+    const Task& task = tasks[id];
+    mark_dirty(task);
+    due_index.erase(task, id);
+    start_index.erase(task, id);
+    reminders.erase(task, id);
+    scheduler.erase(task, id);
+    tasks.erase(id);
+  }
+
+  /**
+   * A function to change every task that matches a predicate in one pass.
+   * The indexes are rebuilt once at the end rather than updated for each task.
+   * @param predicate The function that returns true for the tasks to change.
+   * @param change The function that changes a task, which must not change its username.
+   * @returns The number of tasks changed.
+   */
+  int update_tasks(const std::function<bool(const Task&)>& predicate, const std::function<void(Task&)>& change) {
+    METRICS_TIMER("update_tasks");
+    int changed = 0;
+    for (int i = 0; i < tasks.size(); i++) {
+      if (!predicate(tasks[i])) continue;
+      Task& task = tasks.edit(i);
+      change(task);
+      mark_dirty(task);
+      changed++;
+    }
+    if (changed > 0) index_tasks();
+    return changed;
+  }
+
+  /**
+   * A function to delete every task that matches a predicate in one pass.
+   * The remaining tasks are compacted in order and the indexes are rebuilt once, so deleting k tasks costs O(n) rather than O(k * n).
+   * @param predicate The function that returns true for the tasks to delete.
+   * @returns The number of tasks deleted.
+   */
+  int delete_tasks(const std::function<bool(const Task&)>& predicate) {
+    METRICS_TIMER("delete_tasks");
+    int deleted = tasks.remove_if([&](const Task& task) {
+      if (!predicate(task)) return false;
+      mark_dirty(task);
+      return true;
+    });
+    if (deleted > 0) index_tasks();
+    return deleted;
+  }
+
+  /**
+   * A function to get the path of the single file the data was stored in before it was sharded.
+   * @returns The path of the file named by file_name in the json resources
+   */
+  string data_path() {
+    return path_to_resource(file_name, JSON_RESOURCE);
+  }
+
+  /**
+   * A function to get the path of the directory the shards are stored in.
+   * @returns The path of the data file without its ".json" extension
+   */
+  string shard_directory() {
+    string path = data_path();
+    if (path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0) path.resize(path.size() - 5);
+    return path;
+  }
+
+  /**
+   * A function to get the path of the manifest, which holds the users and the number of shards.
+   * @returns The path of the manifest
+   */
+  string manifest_path() {
+    return shard_directory() + "/manifest.json";
+  }
+
+  /**
+   * A function to get the path of a shard.
+   * @param shard The number of the shard
+   * @returns The path of the shard
+   */
+  string shard_path(int shard) {
+    return shard_directory() + "/" + shard_name(shard, packed);
+  }
+
+  /**
+   * A function to get the file name of a shard.
+   * @param shard The number of the shard
+   * @param packed Whether the shard is in the compact binary format
+   * @returns The file name of the shard
+   */
+  static string shard_name(int shard, bool packed) {
+    return "shard-" + to_string(shard) + (packed ? ".tsk" : ".json");
+  }
+
+  /**
+   * A function to change the format the shards are stored in.
+   * Every shard is marked as changed and the whole store is saved in the new format straight away.
+   * The descriptions and tags are loaded first, since they cannot be read from the old shards once the format changes.
+   * The format is not changed if any shard could not be read or any of them cannot be loaded, since the old shards
+   * are removed after the save. If the save fails, the manifest still names the old format, so the database goes
+   * back to it, with every shard still marked as changed.
+   * @param value True for the compact binary format, false for json
+   * @returns True if the format was changed or was already the same, false otherwise
+   */
+  bool set_packed(bool value) {
+    if (value == packed) return true;
+    finish_save();
+    if (read_only || std::find(unreadable_shards.begin(), unreadable_shards.end(), true) != unreadable_shards.end()) return false;
+    if (!load_bodies()) return false;
+    packed = value;
+    shard_files.clear();
+    dirty_shards.assign(shard_count, true);
+    users_dirty = true;
+    if (save_data()) return true;
+    packed = !value;
+    shard_files.clear();
+    return false;
+  }
+
+  /**
+   * A function to read a whole file into memory.
+   * @param path The path of the file
+   * @param data The contents of the file
+   * @returns True if the file was read, false if it does not exist or could not be read
+   */
+  static bool read_file(const string& path, string& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.seekg(0, std::ios::end);
+    data.resize(file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(&data[0], data.size());
+    return (bool)file;
+  }
+
+  /**
+   * A function to replace a file.
+   * The data is written to a temporary file which is then renamed, so a failed save never leaves a partial file.
+   * @param path The path of the file
+   * @param data The new contents of the file
+   * @returns True if the file was written, false otherwise
+   */
+  static bool write_file(const string& path, const string& data) {
+    string temp_path = path + ".tmp";
+    {
+      std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+      file.write(data.data(), data.size());
+      if (!file) return false;
+    }
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+  }
 
-class Menu {
-  private:
   /**
-   * A function to display a line of dashes to separate sections of the menu.
+   * A function to read an array of users.
+   * @param p The current position, at the opening bracket, advanced past the closing bracket
+   * @param end The end of the buffer
+   * @param out The list to add the users to
+   * @returns True if the array was read, false otherwise
    */
-  static void print_line() {
-    write_line("---------------------------------");
-  } 
+  static bool read_users(const char*& p, const char* end, vector<User>& out) {
+    if (p >= end || *p++ != '[') return false;
+    while (p < end) {
+      Helper::Json::skip_space(p, end);
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      User user;
+      if (!Helper::Json::read_user(p, end, user)) return false;
+      out.push_back(user);
+      Helper::Json::skip_space(p, end);
+      if (p < end && *p == ',') p++;
+    }
+    return false;
+  }
+
   /**
-   * A function to display a line of dashes to separate sections of the menu.
-   * @param heading The heading to display in the menu.
+   * A function to read an array of tasks.
+   * When only the headers are read, the position and length of each task in the file is kept, so load_body can read the rest later.
+   * @param p The current position, at the opening bracket, advanced past the closing bracket
+   * @param begin The start of the buffer, which holds the whole file
+   * @param end The end of the buffer
+   * @param out The list to add the tasks to
+   * @param headers_only Whether to skip the descriptions and tags
+   * @returns True if the array was read, false otherwise
    */
-  static void print_heading(string heading) {
-    write_line();
-    print_line();
-    write_line("Tasky - " + heading);
-    print_line();
+  static bool read_tasks(const char*& p, const char* begin, const char* end, vector<Task>& out, bool headers_only) {
+    if (p >= end || *p++ != '[') return false;
+    while (p < end) {
+      Helper::Json::skip_space(p, end);
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      const char* start = p;
+      Task task;
+      if (!Helper::Json::read_task(p, end, task, headers_only)) return false;
+      if (headers_only) {
+        task.body_offset = start - begin;
+        task.body_length = p - start;
+      }
+      out.push_back(std::move(task));
+      Helper::Json::skip_space(p, end);
+      if (p < end && *p == ',') p++;
+    }
+    return false;
   }
 
-  public:
   /**
-   * A function to display the main menu for the user.
+   * A function to load the data from the single file used before the data was sharded.
+   * Every task is read in full and every shard is marked as changed, so the next save writes the sharded store.
+   * If the file cannot be read or parsed, the database is made read only, so a partial store never replaces it.
+   * @returns True if the file was read or does not exist, false otherwise
    */
-  static void display_user_menu() {
-    print_heading("Main Menu");
-    write_line("1. Login");
-    write_line("2. Register");
-    write_line("3. Exit");
+  bool load_unsharded() {
+    string path = data_path();
+    if (!exists(path)) return true;
+    string data;
+    if (!read_file(path, data)) {
+      read_only = true;
+      return false;
+    }
+    const char* begin = data.data();
+    const char* p = begin;
+    vector<Task> loaded;
+    bool ok = Helper::Json::read_object(p, begin + data.size(), [&](const string& key, const char*& p, const char* end) {
+      if (key == "users") return read_users(p, end, users);
+      if (key == "tasks") return read_tasks(p, begin, end, loaded, false);
+      return Helper::Json::skip_value(p, end);
+    });
+
+    for (int i = 0; i < loaded.size(); i++) {
+      mark_dirty(loaded[i]);
+      tasks.push_back(std::move(loaded[i]));
+    }
+    users_dirty = true;
+    if (!ok) read_only = true;
+    return ok;
   }
+
   /**
-   * A function to display the login or register screen for the user.
-   * @param heading The heading to display in the menu.
-   * @return The user entered by the user.
+   * A function to load the data from the shards listed by a manifest.
+   * The shards are read on a thread pool, one shard per core at a time, and then joined in shard order.
+   * Packed shards are decoded in full, since decoding them is cheaper than parsing the json headers alone.
+   * A shard that cannot be read or parsed keeps the tasks read before the error and is marked as unreadable, so it is
+   * never written. A missing shard is empty, unless the manifest is version 2 or later, which is only written once
+   * every shard exists, in which case it is unreadable too. If the manifest cannot be parsed, no shards are read and
+   * the database is made read only.
+   * @param manifest The contents of the manifest
+   * @returns True if the manifest and every shard were read, false otherwise
    */
-  static User display_login_or_register(string heading) {
-    print_heading(heading);
-    string username = Helper::Reader::read_string("Username: ");
-    string password = Helper::Reader::read_string("Password: ");
-    return User{username, password};
+  bool load_shards(const string& manifest) {
+    const char* p = manifest.data();
+    string format = "json";
+    int version = 1;
+    bool ok = Helper::Json::read_object(p, p + manifest.size(), [&](const string& key, const char*& p, const char* end) {
+      if (key == "version") return Helper::Json::read_integer(p, end, version);
+      if (key == "users") return read_users(p, end, users);
+      if (key == "shard_count") return Helper::Json::read_integer(p, end, shard_count);
+      if (key == "format") return Helper::Json::read_string(p, end, format);
+      return Helper::Json::skip_value(p, end);
+    });
+    if (!ok || shard_count < 1) {
+      read_only = true;
+      return false;
+    }
+    packed = format == "packed";
+    shards_complete = version >= 2;
+
+    // Find the paths first, since SplashKit is not thread safe
+    vector<string> paths(shard_count);
+    for (int i = 0; i < shard_count; i++) paths[i] = shard_path(i);
+
+    // Read the task headers of each shard on its own thread
+    vector<vector<Task>> shards(shard_count);
+    vector<char> failed(shard_count, false);
+    Helper::Parallel::for_each(shard_count, [&](int shard) {
+      if (!exists(paths[shard])) {
+        failed[shard] = shards_complete; // Older stores only wrote a shard once it had tasks
+        return;
+      }
+      string data;
+      if (!read_file(paths[shard], data)) {
+        failed[shard] = true;
+        return;
+      }
+      const char* begin = data.data();
+      const char* p = begin;
+      if (packed) {
+        failed[shard] = !Helper::Packed::read_tasks(p, begin + data.size(), shards[shard]);
+        return;
+      }
+      failed[shard] = !Helper::Json::read_object(p, begin + data.size(), [&](const string& key, const char*& p, const char* end) {
+        if (key == "tasks") return read_tasks(p, begin, end, shards[shard], true);
+        return Helper::Json::skip_value(p, end);
+      });
+    });
+
+    size_t total = tasks.size();
+    for (int i = 0; i < shards.size(); i++) total += shards[i].size();
+    tasks.reserve(total);
+    for (int i = 0; i < shards.size(); i++) {
+      for (int j = 0; j < shards[i].size(); j++)
+        tasks.push_back(std::move(shards[i][j]));
+    }
+    dirty_shards.assign(shard_count, false);
+    users_dirty = false;
+    unreadable_shards.assign(failed.begin(), failed.end());
+    return std::find(failed.begin(), failed.end(), true) == failed.end();
   }
+
   /**
-   * A function to display the main menu for the user.
+   * A function to load the data from the files.
+   * The function reads the manifest and the shards in the directory named by file_name, "data" by default.
+   * If there is no manifest, the function reads the single file named by file_name instead, "data.json" by default.
+   * The function reads the users and tasks from the data and adds them to the users and tasks vectors.
+   * The descriptions and tags of sharded tasks are not read; load_body reads them from the shard when they are needed.
+   * The function builds the date indexes once all the tasks are read.
+   * The function does nothing if the files do not exist or are empty.
+   * @returns True if the data was read, false if some of it could not be read, in which case that part is never written
    */
-  static void display_main_menu() {
-    print_heading("Main Menu");
-    write_line("1. Add Task");
-    write_line("2. View Task");
-    write_line("3. Select Task");
-    write_line("4. Logout");
+  bool load_data() {
+    METRICS_TIMER("load_data");
+    finish_save();
+    shard_files.clear();
+    unreadable_shards.clear();
+    read_only = false;
+    shards_complete = false;
+    string manifest;
+    bool ok = read_file(manifest_path(), manifest) ? load_shards(manifest) : load_unsharded();
+    index_tasks();
+    return ok;
   }
 
   /**
-   * A function to display a task to the user.
-   * @param task The task to display.
-   * @param id The id of the task.
+   * A function to load the description and tags of a task from its shard.
+   * The function does nothing if they are already loaded.
+   * If the shard cannot be read, or the task at the offset is not this task because the shard changed, the task is
+   * left as it is with body_offset kept, so a save never writes it with an empty description and tags.
+   * @param task The task to load, which may be a copy of a task in the database.
+   * @returns True if the description and tags are loaded, false if they could not be read
    */
-  static void display_task(const Task& task, int id) {
-    write_line();
-    write_line("ID: " + to_string(id));
-    write_line("Title: " + task.title);
-    write_line("Description: " + task.description);
-    write_line("Status: " + to_string(task.status));
-    write_line("Priority: " + to_string(task.priority));
-    write_line("Due Date: " + task.due_date);
-    write_line("Start Date: " + task.start_date);
-    if (task.tags.size() > 0) write_line("Tags: " + to_string(task.tags));
+  bool load_body(Task& task) {
+    if (task.body_offset < 0) return true;
+    if (shard_files.size() != shard_count) shard_files.resize(shard_count);
+    int shard = shard_of(task.username);
+    if (!shard_files[shard]) shard_files[shard] = std::make_shared<std::ifstream>(shard_path(shard), std::ios::binary);
+    std::ifstream& file = *shard_files[shard];
+
+    string buffer(task.body_length, '\0');
+    file.clear();
+    file.seekg(task.body_offset);
+    file.read(&buffer[0], buffer.size());
+
+    const char* p = buffer.data();
+    Task full;
+    if (!file || !Helper::Json::read_task(p, p + buffer.size(), full)) return false;
+    if (full.username != task.username || full.title != task.title) return false;
+    task.description = std::move(full.description);
+    task.tags = std::move(full.tags);
+    task.body_offset = -1;
+    return true;
   }
+
   /**
-   * A function to display a list of tasks to the user.
-   * @param tasks The list of tasks to display.
+   * A function to load the descriptions and tags of all the tasks of a user.
+   * @param username The username of the user.
+   * @returns True if every description and tag was loaded, false if any could not be read.
    */
-  static void display_tasks(const vector<Task> &tasks, User user) {
+  bool load_bodies(const string& username) {
+    METRICS_TIMER("load_bodies");
+    bool ok = true;
     for (int i = 0; i < tasks.size(); i++) {
-      if (tasks[i].username == user.username)
-        display_task(tasks[i], i);
+      if (tasks[i].username == username && tasks[i].body_offset >= 0) ok = load_body(tasks.edit(i)) && ok;
     }
+    return ok;
   }
+
   /**
-   * A function to display a list of tasks to the user with a heading.
-   * @param tasks The list of tasks to display.
-   * @param heading The heading to display.
+   * A function to load the descriptions and tags of every task.
+   * @returns True if every description and tag was loaded, false if any could not be read.
    */
-  static void display_tasks(const vector<Task>& tasks, string heading, User user) {
-    print_heading(heading);
-    display_tasks(tasks, user);
+  bool load_bodies() {
+    METRICS_TIMER("load_bodies");
+    bool ok = true;
+    for (int i = 0; i < tasks.size(); i++) {
+      if (tasks[i].body_offset >= 0) ok = load_body(tasks.edit(i)) && ok;
+    }
+    return ok;
   }
+
   /**
-   * A function to display the add task screen for the user.
-   * @return The task entered by the user.
+   * A function to write a snapshot of the data to the files.
+   * The function only reads its arguments, so it can run on another thread while the database is edited.
+   * The snapshot is taken by reference, so this thread never copies or destroys it and every reference count change
+   * stays on the thread that edits the tasks.
+   * @param snapshot The tasks to write, with the descriptions and tags of the tasks in the changed shards loaded
+   * @param users The users to write to the manifest
+   * @param shards The changed shards to write
+   * @param write_manifest Whether to write the manifest, which is skipped if any shard could not be written
+   * @param shard_count The number of shards
+   * @param directory The directory the shards and manifest are stored in
+   * @param packed Whether to write the shards in the compact binary format
+   * @param complete Whether every shard file has been or is being written, which the manifest records as version 2
+   * @returns True if every file was written, false otherwise
    */
-  static Task display_add_task() {
-    print_heading("Add Task");
-    string title = Helper::Reader::read_string("Title: ");
-    string description = Helper::Reader::read_string("Description: ");
-    TaskStatus status = (TaskStatus)Helper::Reader::read_integer("Status (1. TODO, 2. IN PROGRESS, 3. DONE): ", 1, 3);
-    Priority priority = (Priority)Helper::Reader::read_integer("Priority (1. URGENT, 2. HIGH, 3. NORMAL, 4. LOW): ", 1, 4);
-    string start_date = Helper::Reader::read_date("Start Date (YYYY-MM-DD): ");
-    string due_date = Helper::Reader::read_date("Due Date (YYYY-MM-DD): ");
-    vector<string> tags = Helper::Reader::read_tags("Tags (separated by commas): ");
-    return Task{"", title, description, status, priority, due_date, start_date, tags};
+  static bool write_snapshot(const Store::TaskList& snapshot, vector<User> users, vector<int> shards, bool write_manifest, int shard_count, string directory, bool packed, bool complete) {
+    METRICS_TIMER("write_snapshot");
+
+    // Find the tasks of each changed shard
+    vector<int> slot(shard_count, -1);
+    for (int i = 0; i < shards.size(); i++) slot[shards[i]] = i;
+    vector<vector<int>> members(shards.size());
+    for (int i = 0; i < snapshot.size(); i++) {
+      int shard = slot[shard_of(snapshot[i].username, shard_count)];
+      if (shard >= 0) members[shard].push_back(i);
+    }
+
+    // Write the changed shards
+    vector<char> written(shards.size(), false);
+    Helper::Parallel::for_each(shards.size(), [&](int i) {
+      string path = directory + "/" + shard_name(shards[i], packed);
+      if (packed) {
+        vector<const Task*> block;
+        block.reserve(members[i].size());
+        for (int j = 0; j < members[i].size(); j++) block.push_back(&snapshot[members[i][j]]);
+        string out;
+        Helper::Packed::write_tasks(out, block);
+        written[i] = write_file(path, out);
+        return;
+      }
+
+      string out = "{\"tasks\":[";
+      for (int j = 0; j < members[i].size(); j++) {
+        out += j > 0 ? ",\n" : "\n";
+        Helper::Json::write_task(out, snapshot[members[i][j]]);
+      }
+      out += "\n]}\n";
+      written[i] = write_file(path, out);
+    });
+    bool ok = true;
+    for (int i = 0; i < written.size(); i++) ok = ok && written[i];
+
+    // Write the manifest last, and only once every shard is written, so a new store or format is only visible once its
+    // shards exist; otherwise the old manifest stays, and finish_save marks the users as changed so it is retried
+    if (write_manifest && ok) {
+      string out = "{\"version\":" + string(complete ? "2" : "1") + ",\"shard_count\":" + to_string(shard_count);
+      out += ",\"format\":" + string(packed ? "\"packed\"" : "\"json\"") + ",\"users\":[";
+      for (int i = 0; i < users.size(); i++) {
+        out += i > 0 ? ",\n" : "\n";
+        out += "{\"username\":";
+        Helper::Json::write_string(out, users[i].username);
+        out += ",\"password\":";
+        Helper::Json::write_string(out, users[i].password);
+        out += "}";
+      }
+      out += "\n]}\n";
+      ok = write_file(directory + "/manifest.json", out);
+
+      // Remove the shards left over from the other format
+      for (int i = 0; ok && i < shard_count; i++)
+        std::remove((directory + "/" + shard_name(i, !packed)).c_str());
+    }
+    return ok;
   }
+
   /**
-   * A function to display the view task screen for the user.
+   * A function to start saving the data in the background.
+   * The function takes a snapshot of the tasks in constant time and writes it on another thread, so edits can continue.
+   * The shards that have changed are written, and then the manifest if the users have changed and every shard was written.
+   * Shards that have not changed are left as they are, except that every shard is written once for a new store or one
+   * whose manifest is older than version 2, so the manifest can record that they all exist.
+   * The descriptions and tags of the tasks in a changed shard are loaded first, since the old shard is overwritten.
+   * A shard that could not be read, or has descriptions or tags that cannot be loaded, is never written, and its
+   * changes stay marked. Nothing is written if the database is read only, which only counts as a failure once
+   * something has changed.
+   * The function waits for the previous save to finish before starting, and does nothing if nothing has changed.
+   * @returns True if every change is being saved, false if some could not be
    */
-  static void display_view_task_menu() {
-    print_heading("View Task");
-    write_line("1. View All Tasks");
-    write_line("2. View Tasks by Status");
-    write_line("3. View Tasks by Priority");
-    write_line("4. View Tasks by Due Date");
-    write_line("5. View Tasks by Start Date");
-    write_line("6. Back");
+  bool begin_save() {
+    finish_save();
+    if (read_only) return !users_dirty && std::find(dirty_shards.begin(), dirty_shards.end(), true) == dirty_shards.end();
+    string directory = shard_directory();
+    if (dirty_shards.size() != shard_count) dirty_shards.resize(shard_count, false);
+    if (unreadable_shards.size() != shard_count) unreadable_shards.resize(shard_count, false);
+    if (shard_files.size() != shard_count) shard_files.resize(shard_count);
+
+    // Write every shard once, so the manifest can record that a missing shard was lost
+    if (!shards_complete && std::find(unreadable_shards.begin(), unreadable_shards.end(), true) == unreadable_shards.end()) {
+      dirty_shards.assign(shard_count, true);
+      users_dirty = true;
+      shards_complete = true;
+    }
+
+    // Load the bodies that are about to be overwritten
+    for (int i = 0; i < tasks.size(); i++) {
+      int shard = shard_of(tasks[i].username);
+      if (tasks[i].body_offset >= 0 && dirty_shards[shard] && !unreadable_shards[shard] && !load_body(tasks.edit(i))) unreadable_shards[shard] = true;
+    }
+
+    vector<int> shards;
+    bool ok = true;
+    for (int i = 0; i < shard_count; i++) {
+      if (dirty_shards[i] && unreadable_shards[i]) ok = false;
+      else if (dirty_shards[i]) shards.push_back(i);
+    }
+    bool write_manifest = users_dirty || !exists(directory + "/manifest.json");
+    if (shards.empty() && !write_manifest) return ok;
+    create_directories(directory);
+
+    // Close the old files of the shards being written
+    for (int i = 0; i < shards.size(); i++) {
+      shard_files[shards[i]].reset();
+      dirty_shards[shards[i]] = false;
+    }
+    users_dirty = false;
+
+    pending_shards = shards;
+    pending_users = write_manifest;
+    pending_snapshot = tasks.snapshot();
+    pending_save = std::async(std::launch::async, write_snapshot, std::cref(pending_snapshot), users, shards, write_manifest, shard_count, directory, packed, shards_complete).share();
+    return ok;
   }
+
   /**
-   * A function to display the select task screen for the user.
+   * A function to wait for the save running in the background to finish.
+   * If it failed, the shards and users it was writing are marked as changed again, so the next save retries them.
+   * The snapshot is released here, after the save has finished with it.
+   * @returns True if there was no save running or it succeeded, false otherwise
    */
-  static void display_select_task_menu() {
-    print_heading("Select Task");
-    write_line("1. Complete Task");
-    write_line("2. Update Task");
-    write_line("3. Delete Task");
-    write_line("4. Back");
+  bool finish_save() {
+    if (!pending_save.valid()) return true;
+    bool ok = pending_save.get();
+    pending_save = std::shared_future<bool>();
+    pending_snapshot.clear();
+    if (!ok) {
+      for (int i = 0; i < pending_shards.size(); i++) dirty_shards[pending_shards[i]] = true;
+      if (pending_users) users_dirty = true;
+    }
+    pending_shards.clear();
+    return ok;
   }
+
   /**
-   * A function to display the update task screen for the user.
+   * A function to save the data to the files and wait for it to be written.
+   * @returns True if the data was written, false otherwise
    */
-  static void display_sort_task_menu() {
-    print_heading("Sort Task");
-    write_line("1. Sort by Due Date");
-    write_line("2. Sort by Start Date");
-    write_line("3. Back");
+  bool save_data() {
+    METRICS_TIMER("save_data");
+    bool ok = begin_save();
+    return finish_save() && ok;
   }
-};
-
-/**
- * A struct representing a database with a list of users and tasks.
- * The database stores the users and tasks in vectors.
- */
-struct Database {
-  vector<User> users; /**< The list of users in the database */ 
-  vector<Task> tasks; /**< The list of tasks in the database */
 
   /**
-   * A function to load the data from a file.
-   * The function reads the data from a file named "data.json".
-   * The function reads the users and tasks from the data and adds them to the users and tasks vectors.
-   * The function uses the json library to read the data from the file.
-   * The function does nothing if the file does not exist or is empty.
-   */
-  void load_data() {
-    json data = json_from_file("data.json");
-
-    // Check if the data is not empty
-    if (json_count_keys(data) != 0) {
-      // Read the users from the data
-      vector<json> users_json;
-      json_read_array(data, "users", users_json);
-
-      // Loop through the users and add them to the users vector
-      for (int i = 0; i < users_json.size(); i++) {
-        json user_json = users_json[i];
-        string username = json_read_string(user_json, "username");
-        string password = json_read_string(user_json, "password");
-        users.push_back(User{username, password});
-      }
-
-      // Read the tasks from the data
-      vector<json> tasks_json;
-      json_read_array(data, "tasks", tasks_json);
-
-      // Loop through the tasks and add them to the tasks vector
-      for (int i = 0; i < tasks_json.size(); i++) {
-        json task_json = tasks_json[i];
-        string username = json_read_string(task_json, "username");
-        string title = json_read_string(task_json, "title");
-        string description = json_read_string(task_json, "description");
-        TaskStatus status = (TaskStatus)json_read_number(task_json, "status");
-        Priority priority = (Priority)json_read_number(task_json, "priority");
-        string due_date = json_read_string(task_json, "due_date");
-        string start_date = json_read_string(task_json, "start_date");
-        vector<string> tags;
-        json_read_array(task_json, "tags", tags);
-        tasks.push_back(Task{username, title, description, status, priority, due_date, start_date, tags});
-      }
-    }
-    free_all_json();
-  }
-
-  /**
-   * A function to save the data to a file.
-   * The function creates a json object and adds the users and tasks to the data.
-   * The function writes the data to a file named "data.json".
-   * The function creates a directory named "json" if it does not exist.
-   * The function writes the data to the file using the json_to_file function.
-   */
-  void save_data() {
-    json data = create_json();
-
-    // Add the users to the data
-    vector<json> users_json;
-    for (int i = 0; i < users.size(); i++) {
-      json user_json = create_json();
-      json_set_string(user_json, "username", users[i].username);
-      json_set_string(user_json, "password", users[i].password);
-      users_json.push_back(user_json);
-    }
-    json_set_array(data, "users", users_json);
-
-    // Add the tasks to the data
-    vector<json> tasks_json;
-    for (int i = 0; i < tasks.size(); i++) {
-      json task_json = create_json();
-      json_set_string(task_json, "username", tasks[i].username);
-      json_set_string(task_json, "title", tasks[i].title);
-      json_set_string(task_json, "description", tasks[i].description);
-      json_set_number(task_json, "status", tasks[i].status);
-      json_set_number(task_json, "priority", tasks[i].priority);
-      json_set_string(task_json, "due_date", tasks[i].due_date);
-      json_set_string(task_json, "start_date", tasks[i].start_date);
-      json_set_array(task_json, "tags", tasks[i].tags);
-      tasks_json.push_back(task_json);
+   * A function to start publishing the data to a shared memory region for other local processes to read.
+   * The current data is published straight away, and publish updates it after each change.
+   * @param name The name of the region, e.g. "/tasky"
+   * @returns True if the region was opened, false otherwise
+   */
+  bool share(const string& name) {
+    shared = std::make_shared<Shared::Writer>();
+    if (!shared->open(name)) {
+      shared.reset();
+      return false;
     }
-    json_set_array(data, "tasks", tasks_json);
+    published_changes = changes - 1; // Differs from changes, so the current data is published
+    publish();
+    return true;
+  }
 
-    // if file does not exist
-    if (json_count_keys(json_from_file("data.json")) == 0) {
-      create_directory("json");
-      std::ofstream file("json/data.json");
-    }
+  /**
+   * A function to publish the data to the shared memory region if it has changed since it was last published.
+   * The descriptions and tags are loaded first, since readers get every field of every task.
+   * Nothing is published if any of them cannot be loaded, so readers keep the last whole version.
+   * The data is encoded before the region is touched, so readers only wait for the copy.
+   */
+  void publish() {
+    if (!shared || changes == published_changes) return;
+    METRICS_TIMER("publish");
+    if (!load_bodies()) return;
 
-    // Write the data to the file
-    json_to_file(data, "data.json");
-    free_all_json();
+    string data = Shared::encode(users, tasks);
+    if (shared->publish(data)) published_changes = changes;
   }
 };
 
@@ -485,13 +2699,14 @@ struct Manager {
    * @param user The user to register.
    */
   bool register_user(const User& user) {
+    METRICS_TIMER("register_user");
     for (int i = 0; i < db.users.size(); i++) {
       if (db.users[i].username == user.username) {
         return false;
       }
     }
 
-    db.users.push_back(user);
+    db.add_user(user);
     return true;
   }
 
@@ -501,6 +2716,7 @@ struct Manager {
    * The function returns true if the login is successful, false otherwise.
    */
   bool login_user(const User& user) {
+    METRICS_TIMER("login_user");
     for (int i = 0; i < db.users.size(); i++) {
       if (db.users[i].username == user.username && db.users[i].password == user.password) {
         return true;
@@ -518,25 +2734,242 @@ struct Manager {
    * @param task The task to add to the database.
    */
   void add_task(Task& task) {
+    METRICS_TIMER("add_task");
     if (is_logged_in) {
       task.username = user.username;
-      db.tasks.push_back(task);
+      db.add_task(task);
+      METRICS_COUNT("tasks_added");
     }
     else write_line("Please login to add a task.");
   }
 
+  /**
+   * A function to find the open tasks of the user that are past their due date.
+   * The function uses the due date index, so only the tasks before today are visited.
+   * @returns The positions of the overdue tasks in due date order.
+   */
+  vector<int> overdue_tasks() {
+    METRICS_TIMER("overdue_tasks");
+    vector<int> result;
+    vector<int> ids = db.due_index.range(user.username, "", Helper::Date::today());
+    for (int i = 0; i < ids.size(); i++) {
+      if (db.tasks[ids[i]].status != COMPLETED) result.push_back(ids[i]);
+    }
+    return result;
+  }
+
+  /**
+   * A function to find the open tasks of the user that are due within a number of days.
+   * The function uses the due date index, so only the tasks in the range are visited.
+   * @param days The number of days from today to include.
+   * @returns The positions of the tasks due soon in due date order.
+   */
+  vector<int> due_soon_tasks(int days) {
+    METRICS_TIMER("due_soon_tasks");
+    vector<int> result;
+    string today = Helper::Date::today();
+    vector<int> ids = db.due_index.range(user.username, today, Helper::Date::add_days(today, days + 1));
+    for (int i = 0; i < ids.size(); i++) {
+      if (db.tasks[ids[i]].status != COMPLETED) result.push_back(ids[i]);
+    }
+    return result;
+  }
+
+  /**
+   * A function to find the tasks the user should work on next.
+   * Open tasks are ranked by priority, then due date, then status, with tasks in progress before tasks still to do.
+   * The function uses the scheduler heap, so it takes O(count log count) time and the tasks are not scanned or sorted.
+   * @param count The largest number of tasks to return.
+   * @returns The positions of the tasks, most pressing first.
+   */
+  vector<int> next_tasks(int count) {
+    METRICS_TIMER("next_tasks");
+    return db.scheduler.top(user.username, count);
+  }
+
+  /**
+   * A function to remind the user of their next due task.
+   * The function uses the reminder heap, so the tasks are not scanned.
+   * The function displays nothing if the next task is not due within a week.
+   */
+  void remind() {
+    METRICS_TIMER("remind");
+    int id = db.reminders.next(user.username, db.tasks);
+    if (id == -1) return;
+
+    string today = Helper::Date::today();
+    const Task& task = db.tasks[id];
+    if (task.due_date <= Helper::Date::add_days(today, 7))
+      Menu::display_reminder(task, task.due_date < today);
+  }
+
+  /**
+   * A function to split the tasks by status.
+   * @param todo The tasks to be done.
+   * @param in_progress The tasks in progress.
+   * @param completed The tasks that are done.
+   */
+  void group_by_status(vector<Task>& todo, vector<Task>& in_progress, vector<Task>& completed) {
+    METRICS_TIMER("group_by_status");
+    for (int i = 0; i < db.tasks.size(); i++) {
+      const Task& task = db.tasks[i];
+      if (task.status == TODO) todo.push_back(task);
+      if (task.status == IN_PROGRESS) in_progress.push_back(task);
+      if (task.status == COMPLETED) completed.push_back(task);
+    }
+  }
+
+  /**
+   * A function to split the tasks by priority.
+   * @param urgent The urgent tasks.
+   * @param high The high priority tasks.
+   * @param normal The normal priority tasks.
+   * @param low The low priority tasks.
+   */
+  void group_by_priority(vector<Task>& urgent, vector<Task>& high, vector<Task>& normal, vector<Task>& low) {
+    METRICS_TIMER("group_by_priority");
+    for (int i = 0; i < db.tasks.size(); i++) {
+      const Task& task = db.tasks[i];
+      if (task.priority == URGENT) urgent.push_back(task);
+      if (task.priority == HIGH) high.push_back(task);
+      if (task.priority == NORMAL) normal.push_back(task);
+      if (task.priority == LOW) low.push_back(task);
+    }
+  }
+
+  /**
+   * A function to find the tasks of the user in due date order.
+   * The function uses the due date index, so the tasks are not copied or sorted.
+   * @returns The positions of the tasks in due date order.
+   */
+  vector<int> tasks_by_due_date() {
+    METRICS_TIMER("tasks_by_due_date");
+    return db.due_index.all(user.username);
+  }
+
+  /**
+   * A function to find the tasks of the user in start date order.
+   * The function uses the start date index, so the tasks are not copied or sorted.
+   * @returns The positions of the tasks in start date order.
+   */
+  vector<int> tasks_by_start_date() {
+    METRICS_TIMER("tasks_by_start_date");
+    return db.start_index.all(user.username);
+  }
+
+  /**
+   * A function to mark a task as completed.
+   * @param id The position of the task in the database.
+   */
+  void complete_task(int id) {
+    METRICS_TIMER("complete_task");
+    METRICS_COUNT("tasks_completed");
+    Task task = db.tasks[id];
+    task.status = COMPLETED;
+    db.update_task(id, task);
+  }
+
+  /**
+   * A function to mark every open task of the user with a tag as completed.
+   * The function loads the tags of the user's tasks first, since the predicate reads them.
+   * @param tag The tag to match.
+   * @returns The number of tasks completed, or -1 if the tags could not be read.
+   */
+  int complete_tagged(const string& tag) {
+    if (!db.load_bodies(user.username)) return -1;
+    return db.update_tasks([&](const Task& task) {
+      return task.username == user.username && task.status != COMPLETED &&
+        std::find(task.tags.begin(), task.tags.end(), tag) != task.tags.end();
+    }, [](Task& task) {
+      task.status = COMPLETED;
+    });
+  }
+
+  /**
+   * A function to delete every completed task of the user that was due before a date.
+   * @param date The date to compare the due dates with, in the format "YYYY-MM-DD".
+   * @returns The number of tasks deleted.
+   */
+  int delete_completed_before(const string& date) {
+    return db.delete_tasks([&](const Task& task) {
+      return task.username == user.username && task.status == COMPLETED && task.due_date < date;
+    });
+  }
+
+  /**
+   * A function to change the priority of every open task of the user that is past its due date.
+   * @param priority The new priority.
+   * @returns The number of tasks changed.
+   */
+  int reprioritize_overdue(Priority priority) {
+    string today = Helper::Date::today();
+    return db.update_tasks([&](const Task& task) {
+      return task.username == user.username && task.status != COMPLETED && task.due_date < today && task.priority != priority;
+    }, [&](Task& task) {
+      task.priority = priority;
+    });
+  }
+
+  /**
+   * A function to show the user the tasks they should work on next.
+   * The function prompts the user for the number of tasks, and loads the descriptions and tags of only those tasks.
+   */
+  void view_next_tasks() {
+    int count = Helper::Reader::read_integer("How many tasks? ", 1, 100);
+    vector<int> ids = next_tasks(count);
+    bool ok = true;
+    for (int i = 0; i < ids.size(); i++) {
+      if (db.tasks[ids[i]].body_offset >= 0) ok = db.load_body(db.tasks.edit(ids[i])) && ok;
+    }
+    Menu::display_tasks(db.tasks, ids, "Next Tasks");
+    if (!ok) write_line("Some descriptions and tags could not be read.");
+  }
+
+  /**
+   * A function to carry out the bulk actions menu.
+   * Each action changes every matching task of the user in a single pass over the database.
+   */
+  void bulk_actions() {
+    Menu::display_bulk_menu();
+    int choice = Helper::Reader::read_integer("Enter your choice: ", 1, 4);
+
+    switch (choice) {
+      case 1: {
+        string tag = Helper::Reader::read_string("Enter the tag: ");
+        int completed = complete_tagged(tag);
+        if (completed < 0) write_line("Could not read the tags of your tasks.");
+        else write_line(to_string(completed) + " tasks completed.");
+        break;
+      }
+      case 2: {
+        string date = Helper::Reader::read_date("Enter the date (YYYY-MM-DD): ");
+        write_line(to_string(delete_completed_before(date)) + " tasks deleted.");
+        break;
+      }
+      case 3: {
+        Priority priority = (Priority)Helper::Reader::read_integer("Enter the new priority (1. URGENT, 2. HIGH, 3. NORMAL, 4. LOW): ", 1, 4);
+        write_line(to_string(reprioritize_overdue(priority)) + " tasks reprioritized.");
+        break;
+      }
+      case 4:
+        break;
+    }
+  }
+
   /**
    * A function to carry out the view tasks menu
    * The function displays a menu to the user with options to view tasks by different criteria.
    * The function displays the tasks to the user based on the selected criteria.
+   * The function loads the descriptions and tags of the user's tasks, since every view displays them.
    */
   void view_tasks() {
     bool go_back = false;
     int choice;
+    if (!db.load_bodies(user.username)) write_line("Some descriptions and tags could not be read.");
 
     do {
       Menu::display_view_task_menu();
-      choice = Helper::Reader::read_integer("Enter your choice: ", 1, 7);
+      choice = Helper::Reader::read_integer("Enter your choice: ", 1, 8);
 
       switch (choice) {
         case 1: {
@@ -547,12 +2980,7 @@ struct Manager {
           vector<Task> todoTasks;
           vector<Task> inProgressTasks;
           vector<Task> completedTasks;
-          for (int i = 0; i < db.tasks.size(); i++) {
-            Task task = db.tasks[i];
-            if (task.status == TODO) todoTasks.push_back(task);
-            if (task.status == IN_PROGRESS) inProgressTasks.push_back(task);
-            if (task.status == COMPLETED) completedTasks.push_back(task);
-          }
+          group_by_status(todoTasks, inProgressTasks, completedTasks);
           Menu::display_tasks(todoTasks, "Todo Tasks", user);
           Menu::display_tasks(inProgressTasks, "In Progress Tasks", user);
           Menu::display_tasks(completedTasks, "Completed Tasks", user);
@@ -563,46 +2991,26 @@ struct Manager {
           vector<Task> highTasks;
           vector<Task> normalTasks;
           vector<Task> lowTasks;
-          for (int i = 0; i < db.tasks.size(); i++) {
-            Task task = db.tasks[i];
-            if (task.priority == URGENT) urgentTasks.push_back(task);
-            if (task.priority == HIGH) highTasks.push_back(task);
-            if (task.priority == NORMAL) normalTasks.push_back(task);
-            if (task.priority == LOW) lowTasks.push_back(task);
-          }
+          group_by_priority(urgentTasks, highTasks, normalTasks, lowTasks);
           Menu::display_tasks(urgentTasks, "Urgent Tasks", user);
           Menu::display_tasks(highTasks, "High Tasks", user);
           Menu::display_tasks(normalTasks, "Normal Tasks", user);
           Menu::display_tasks(lowTasks, "Low Tasks", user);
           break;  
         }
-        case 4: {
-          vector<Task> sortedTasks = db.tasks;
-          Helper::Date::sort_date(sortedTasks, [](vector<Task>& tasks, bool &swapped, int &j) {
-            if (tasks[j].due_date > tasks[j + 1].due_date) {
-              Task temp = tasks[j];
-              tasks[j] = tasks[j + 1];
-              tasks[j + 1] = temp;
-              swapped = true;
-            }
-          });
-          Menu::display_tasks(sortedTasks, "Tasks by Due Date", user);
+        case 4:
+          Menu::display_tasks(db.tasks, tasks_by_due_date(), "Tasks by Due Date");
           break;
-        }
-        case 5: {
-          vector<Task> sortedTasks = db.tasks;
-          Helper::Date::sort_date(sortedTasks, [](vector<Task>& tasks, bool &swapped, int &j) {
-            if (tasks[j].start_date > tasks[j + 1].start_date) {
-              Task temp = tasks[j];
-              tasks[j] = tasks[j + 1];
-              tasks[j + 1] = temp;
-              swapped = true;
-            }
-          });
-          Menu::display_tasks(sortedTasks, "Tasks by Start Date", user);
+        case 5:
+          Menu::display_tasks(db.tasks, tasks_by_start_date(), "Tasks by Start Date");
           break;
-        }
-        case 6: 
+        case 6:
+          Menu::display_tasks(db.tasks, overdue_tasks(), "Overdue Tasks");
+          break;
+        case 7:
+          Menu::display_tasks(db.tasks, due_soon_tasks(7), "Tasks Due in the Next 7 Days");
+          break;
+        case 8: 
           go_back = true;
           break;
       }
@@ -618,10 +3026,14 @@ struct Manager {
   void select_task() {
     int id = Helper::Reader::read_integer("Enter the task ID: ");
     bool is_running = true;
-    if (id < 0 || id > db.tasks.size()) {
+    if (id < 0 || id >= db.tasks.size()) {
       write_line("Invalid task ID.");
       return;
     }
+    if (db.tasks[id].body_offset >= 0 && !db.load_body(db.tasks.edit(id))) {
+      write_line("Could not read the description and tags of the task.");
+      return;
+    }
     Task task = db.tasks[id];
 
     do {
@@ -631,8 +3043,7 @@ struct Manager {
 
       switch (choice) {
         case 1:
-          task.status = COMPLETED;
-          db.tasks[id] = task;
+          complete_task(id);
           write_line("Task completed successfully.");
           is_running = false;
           break;
@@ -669,16 +3080,11 @@ struct Manager {
                 break;
             }
           } while (update_choice != 8);
-          db.tasks[id] = task;
+          db.update_task(id, task);
           break;
         }
         case 3:
-          for (int i = 0; i < db.tasks.size(); i++) {
-            if (i == id) {
-              db.tasks.erase(db.tasks.begin() + i);
-              break;
-            }
-          }
+          db.delete_task(id);
           write_line("Task deleted successfully.");
           is_running = false;
           break;
@@ -690,6 +3096,7 @@ struct Manager {
   }
 };
 
+#ifndef TASKY_NO_MAIN
 int main() {
   Manager manager = Manager{
     User{"", ""},
@@ -698,7 +3105,11 @@ int main() {
       vector<Task>{}
     }
   };
-  manager.db.load_data();
+  if (!manager.db.load_data()) write_line("Some of the data could not be read, so changes to it will not be saved.");
+  const char* format = std::getenv("TASKY_STORE_FORMAT");
+  if (format && *format && !manager.db.set_packed(string(format) == "packed")) write_line("Could not read or write every task, so the store format was not changed.");
+  const char* region = std::getenv("TASKY_SHM");
+  if (region && *region && !manager.db.share(region)) write_line("Could not open the shared memory region " + string(region) + ", or another tasky is already publishing to it.");
 
   int choice;
   do {
@@ -712,6 +3123,7 @@ int main() {
           manager.user = user;
           manager.is_logged_in = true;
           write_line("Login successful.");
+          manager.remind();
         }
         else write_line("Invalid username or password.");
         break;
@@ -734,7 +3146,7 @@ int main() {
     if (manager.is_logged_in) {
       do {
         Menu::display_main_menu();
-        choice = Helper::Reader::read_integer("Enter your choice: ", 1, 5);
+        choice = Helper::Reader::read_integer("Enter your choice: ", 1, 6);
 
         switch (choice) {
           case 1: {
@@ -749,14 +3161,28 @@ int main() {
             manager.select_task();
             break;
           case 4:
+            manager.view_next_tasks();
+            break;
+          case 5:
+            manager.bulk_actions();
+            break;
+          case 6:
             manager.is_logged_in = false;
             break;
         }
+        if (!manager.db.begin_save()) write_line("Some changes could not be saved, since their shards could not be read.");
+        manager.db.publish();
       } while (manager.is_logged_in);
     }
+    manager.db.publish();
   } while (manager.is_running);
 
-  manager.db.save_data();
+  if (!manager.db.save_data()) write_line("Some changes could not be saved.");
+  METRICS_DUMP_FROM_ENV();
 }
+#endif
 
-// clang++ tasky.cpp -o tasky -lstdc++fs -l SplashKit && ./tasky
\ No newline at end of file
+// clang++ tasky.cpp -o tasky -lstdc++fs -l SplashKit && ./tasky
+// Add -D TASKY_METRICS to record timings, and set TASKY_METRICS_FILE=metrics.prom (or metrics.json) to write them on exit.
+// Set TASKY_SHM=/tasky to publish the data to shared memory for local tools to read, see shared.h (add -l rt on glibc older than 2.34).
+// Set TASKY_STORE_FORMAT=packed to convert the store to the compact binary format on the next save, or TASKY_STORE_FORMAT=json to convert it back.
\ No newline at end of file